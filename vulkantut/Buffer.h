@@ -0,0 +1,80 @@
+#pragma once
+
+#include "LogicalDevice.h"
+
+#include "vulkan_include.h"
+#include "utils.h"
+#include "vk_utils.h"
+
+using namespace std;
+using namespace utils;
+
+/***
+ * VkBuffer + the memory backing it (sub-allocated, see MemoryAllocator)
+ */
+class Buffer {
+  ptr<LogicalDevice> device;
+  VkBuffer buffer;
+  MemoryAllocation memory;
+
+public:
+  const VkDeviceSize size;
+
+  VkBuffer get() { return buffer; }
+
+  // null unless the buffer is in host visible memory
+  char* mapped() { return static_cast<char*>(memory.mapped); }
+
+  Buffer(
+    ptr<LogicalDevice> device,
+    VkDeviceSize size,
+    VkBufferUsageFlags usage, // bitwise or for multiple usages
+    VkMemoryPropertyFlags props
+  ) : device(device)
+    , size(size)
+  {
+    VkBufferCreateInfo info = {};
+    info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    info.size = size;
+    info.usage = usage;
+
+    // buffers can be owned by a specific queue family or be shared between
+    // multiple at the same time
+    info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    if (vkCreateBuffer(device->get(), &info, nullptr, &buffer) != VK_SUCCESS) {
+      throw runtime_error("failed to create buffer");
+    }
+
+    VkMemoryRequirements memreqs;
+    vkGetBufferMemoryRequirements(device->get(), buffer, &memreqs);
+
+    /*
+    *   Unfortunately the driver may not immediately copy the data into the
+    *   buffer memory, for example because of caching. It is also possible that
+    *   writes to the buffer are not visible in the mapped memory yet. There
+    *   are two ways to deal with that problem:
+    * 
+    * 1. Use a memory heap that is host coherent, indicated with VK_MEMORY_PROPERTY_HOST_COHERENT_BIT 
+    * 2. Call vkFlushMappedMemoryRanges after writing to the mapped memory, and
+    *    call vkInvalidateMappedMemoryRanges before reading from the mapped memory
+    * 
+    * Flushing memory ranges or using a coherent memory heap means that the
+    * driver will be aware of our writes to the buffer, but it doesn't mean
+    * that they are actually visible on the GPU yet. The transfer of data to
+    * the GPU is an operation that happens in the background and the
+    * specification simply tells us that it is guaranteed to be complete as of
+    * the next call to vkQueueSubmit.
+    */
+    memory = device->allocator->alloc(memreqs, props, true);
+    vkBindBufferMemory(device->get(), buffer, memory.memory, memory.offset);
+  }
+
+  ~Buffer() {
+    auto allocator = device->allocator.get();
+    device->deletion_queue->push([device = device->get(), allocator, buffer = buffer, memory = memory]() {
+      vkDestroyBuffer(device, buffer, nullptr);
+      allocator->free(memory);
+    });
+  }
+};
@@ -16,7 +16,14 @@ class Command {
   vector<VkCommandBuffer> buffers;
 
 public:
-  Command(ptr<LogicalDevice> device, u32 qfam_index, u32 num_buffers) : device(device) {
+  // command buffers of a pool can only be recorded by one thread at a time, threads recording in
+  // parallel each need their own (see Frame::record_secondaries)
+  Command(
+    ptr<LogicalDevice> device,
+    u32 qfam_index,
+    u32 num_buffers,
+    VkCommandBufferLevel level = VK_COMMAND_BUFFER_LEVEL_PRIMARY
+  ) : device(device) {
     VkCommandPoolCreateInfo pool_create_info{};
     pool_create_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
     pool_create_info.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
@@ -29,7 +36,7 @@ public:
     VkCommandBufferAllocateInfo alloc_info{};
     alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
     alloc_info.commandPool = pool;
-    alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    alloc_info.level = level;
     alloc_info.commandBufferCount = num_buffers;
 
     buffers.resize(num_buffers);
@@ -40,10 +47,17 @@ public:
 
   VkCommandBuffer get_buffer(u32 i) { return buffers[i]; }
 
+  // resets all the buffers at once, cheaper than one by one. None of them may be pending
+  void reset() {
+    vkResetCommandPool(device->get(), pool, 0);
+  }
+
   ~Command() {
     //command buffers are freed for us when we free the command pool (?)
     //vkFreeCommandBuffers(device->get(), pool, buffers.size(), buffers.data());
 
-    vkDestroyCommandPool(device->get(), pool, nullptr);
+    device->deletion_queue->push([device = device->get(), pool = pool]() {
+      vkDestroyCommandPool(device, pool, nullptr);
+    });
   }
 };
@@ -0,0 +1,104 @@
+#pragma once
+
+#include "LogicalDevice.h"
+#include "Command.h"
+#include "IndexBuffer.h"
+
+#include "vulkan_include.h"
+#include "utils.h"
+#include "vk_utils.h"
+
+using namespace std;
+using namespace utils;
+
+/***
+ * one pre-recorded command buffer per framebuffer, replayed every frame instead of recording the
+ * same commands over and over. For a mostly static scene the CPU side of a frame is then just
+ * acquire + submit + present.
+ *
+ * a buffer is re-recorded (lazily, the next time its framebuffer is drawn to) if it was marked
+ * dirty, or if anything it was recorded w/ changed (see Key). Only that buffer, the others keep
+ * being replayed.
+ *
+ * a buffer can't be re-recorded / resubmitted while it's still pending. Callers must have waited
+ * for the last submission that used it, which the images_inflight fences / frames of the swapchain
+ * (or the frame's own wait() when rendering offscreen, one framebuffer per frame) already guarantee
+ */
+class CommandCache {
+public:
+  // everything the commands depend on
+  struct Key {
+    VkFramebuffer framebuffer;
+    VkPipeline pipeline;
+    VkExtent2D extent;
+    Geometry geometry;
+
+    bool operator==(const Key& other) const {
+      const VertexSpan& v = geometry.vertices;
+      const VertexSpan& ov = other.geometry.vertices;
+      const IndexSpan& i = geometry.indices;
+      const IndexSpan& oi = other.geometry.indices;
+      const InstanceSpan& n = geometry.instances;
+      const InstanceSpan& on = other.geometry.instances;
+
+      return
+        framebuffer == other.framebuffer &&
+        pipeline == other.pipeline &&
+        extent.width == other.extent.width &&
+        extent.height == other.extent.height &&
+        v.buffer == ov.buffer && v.offset == ov.offset && v.count == ov.count &&
+        i.buffer == oi.buffer && i.offset == oi.offset && i.count == oi.count && i.type == oi.type &&
+        n.buffer == on.buffer && n.offset == on.offset && n.count == on.count &&
+        geometry.culling == other.geometry.culling &&
+        geometry.animator == other.geometry.animator &&
+        geometry.draws == other.geometry.draws;
+    }
+  };
+
+private:
+  ptr<Command> command;
+  vector<Key> keys;
+  vector<bool> dirty;
+
+public:
+  u32 records = 0;
+  u32 replays = 0;
+
+  CommandCache(ptr<LogicalDevice> device, u32 qfam_index, u32 num_framebuffers)
+    : keys(num_framebuffers)
+    , dirty(num_framebuffers, true)
+  {
+    command = mk_ptr<Command>(device, qfam_index, num_framebuffers);
+  }
+
+  u32 size() const { return static_cast<u32>(dirty.size()); }
+
+  // e.g. the scene changed in a way the Key doesn't capture (same buffers, new contents)
+  void mark_dirty() {
+    fill(dirty.begin(), dirty.end(), true);
+  }
+
+  void mark_dirty(u32 index) {
+    dirty[index] = true;
+  }
+
+  // the buffer for framebuffer index. Sets record if the caller must (re-)record it before
+  // submitting it; it's then considered up to date w/ key
+  VkCommandBuffer get(u32 index, const Key& key, bool& record) {
+    record = dirty[index] || !(keys[index] == key);
+
+    if (record) {
+      keys[index] = key;
+      dirty[index] = false;
+      records += 1;
+    } else {
+      replays += 1;
+    }
+
+    return command->get_buffer(index);
+  }
+
+  string to_str() const {
+    return format("command cache: {} buffers, {} recorded, {} replayed", size(), records, replays);
+  }
+};
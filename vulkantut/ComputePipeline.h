@@ -0,0 +1,249 @@
+#pragma once
+
+#include "LogicalDevice.h"
+#include "Shader.h"
+
+#include "vulkan_include.h"
+#include "utils.h"
+#include "vk_utils.h"
+
+using namespace std;
+using namespace utils;
+
+/***
+ * a compute shader w/ one descriptor per binding of set 0 (storage buffers / images, uniform
+ * buffers, ...) and an optional push constant block. Descriptor sets come from the pipeline's own
+ * pool, see make_set()
+ */
+class ComputePipeline {
+  ptr<LogicalDevice> device;
+  VkDescriptorSetLayout set_layout;
+  VkPipelineLayout layout;
+  VkPipeline pipeline;
+  VkDescriptorPool pool;
+  vector<VkDescriptorType> bindings; // type of binding i
+  u32 push_size;
+
+  static bool is_image(VkDescriptorType type) {
+    return
+      type == VK_DESCRIPTOR_TYPE_STORAGE_IMAGE ||
+      type == VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE ||
+      type == VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+  }
+
+  u32 num_bindings(bool images) const {
+    return static_cast<u32>(count_if(bindings.begin(), bindings.end(), [images](VkDescriptorType type) {
+      return is_image(type) == images;
+    }));
+  }
+
+public:
+  double create_ms; // time spent in vkCreateComputePipelines
+
+  VkPipeline get() { return pipeline; }
+
+  // bindings[i] is the type of binding i
+  ComputePipeline(
+    ptr<LogicalDevice> device,
+    const string& shader,
+    const vector<VkDescriptorType>& bindings,
+    u32 push_size = 0, // bytes of push constants
+    u32 max_sets = 1,
+    const SpecConstants* constants = nullptr
+  ) : device(device)
+    , bindings(bindings)
+    , push_size(push_size)
+  {
+    u32 binding_count = static_cast<u32>(bindings.size());
+
+    vector<VkDescriptorSetLayoutBinding> layout_bindings(binding_count);
+    for (u32 i = 0; i < binding_count; ++i) {
+      layout_bindings[i].binding = i;
+      layout_bindings[i].descriptorType = bindings[i];
+      layout_bindings[i].descriptorCount = 1;
+      layout_bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    }
+
+    VkDescriptorSetLayoutCreateInfo set_info{};
+    set_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    set_info.bindingCount = binding_count;
+    set_info.pBindings = layout_bindings.data();
+
+    if (vkCreateDescriptorSetLayout(device->get(), &set_info, nullptr, &set_layout) != VK_SUCCESS) {
+      throw runtime_error("failed to create descriptor set layout");
+    }
+
+    VkPushConstantRange push_range{};
+    push_range.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    push_range.offset = 0;
+    push_range.size = push_size;
+
+    VkPipelineLayoutCreateInfo layout_info{};
+    layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    layout_info.setLayoutCount = 1;
+    layout_info.pSetLayouts = &set_layout;
+    layout_info.pushConstantRangeCount = push_size > 0 ? 1 : 0;
+    layout_info.pPushConstantRanges = &push_range;
+
+    if (vkCreatePipelineLayout(device->get(), &layout_info, nullptr, &layout) != VK_SUCCESS) {
+      throw runtime_error("failed to create compute pipeline layout");
+    }
+
+    Shader comp(device, shader);
+
+    VkComputePipelineCreateInfo pipeline_info{};
+    pipeline_info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipeline_info.stage = comp.pipeline_stage(VK_SHADER_STAGE_COMPUTE_BIT, constants);
+    pipeline_info.layout = layout;
+
+    auto start = chrono::steady_clock::now();
+    VkPipelineCache cache = device->pipeline_cache->get();
+    if (vkCreateComputePipelines(device->get(), cache, 1, &pipeline_info, nullptr, &pipeline) != VK_SUCCESS) {
+      throw runtime_error(format("failed to create compute pipeline for {}", shader));
+    }
+    create_ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+    // one size per type, a pool can't be created w/o any
+    vector<VkDescriptorPoolSize> pool_sizes;
+    for (VkDescriptorType type : bindings) {
+      auto same_type = [type](const VkDescriptorPoolSize& size) { return size.type == type; };
+      auto it = find_if(pool_sizes.begin(), pool_sizes.end(), same_type);
+      if (it == pool_sizes.end()) {
+        pool_sizes.push_back({ type, 0 });
+        it = pool_sizes.end() - 1;
+      }
+      it->descriptorCount += max_sets;
+    }
+    if (pool_sizes.empty()) {
+      pool_sizes.push_back({ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, max_sets });
+    }
+
+    VkDescriptorPoolCreateInfo pool_info{};
+    pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    pool_info.maxSets = max_sets;
+    pool_info.poolSizeCount = static_cast<u32>(pool_sizes.size());
+    pool_info.pPoolSizes = pool_sizes.data();
+
+    if (vkCreateDescriptorPool(device->get(), &pool_info, nullptr, &pool) != VK_SUCCESS) {
+      throw runtime_error("failed to create descriptor pool");
+    }
+  }
+
+  // num_buffers storage buffers, bindings 0 - num_buffers-1
+  ComputePipeline(
+    ptr<LogicalDevice> device,
+    const string& shader,
+    u32 num_buffers,
+    u32 push_size = 0,
+    u32 max_sets = 1,
+    const SpecConstants* constants = nullptr
+  ) : ComputePipeline(
+      device,
+      shader,
+      vector<VkDescriptorType>(num_buffers, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER),
+      push_size,
+      max_sets,
+      constants
+    )
+  {}
+
+  ~ComputePipeline() {
+    VkDescriptorSetLayout set_layout = this->set_layout;
+    VkPipelineLayout layout = this->layout;
+    device->deletion_queue->push([device = device->get(), set_layout, layout, pipeline = pipeline, pool = pool]() {
+      vkDestroyDescriptorPool(device, pool, nullptr); // frees its sets too
+      vkDestroyPipeline(device, pipeline, nullptr);
+      vkDestroyPipelineLayout(device, layout, nullptr);
+      vkDestroyDescriptorSetLayout(device, set_layout, nullptr);
+    });
+  }
+
+  // buffers go to the buffer bindings and images to the image ones, each in binding order. Buffers
+  // are bound whole (VK_WHOLE_SIZE) unless a range is given, storage images must be in
+  // VK_IMAGE_LAYOUT_GENERAL when dispatched
+  VkDescriptorSet make_set(
+    const vector<VkDescriptorBufferInfo>& buffers,
+    const vector<VkDescriptorImageInfo>& images = {}
+  ) {
+    if (buffers.size() != num_bindings(false) || images.size() != num_bindings(true)) {
+      throw runtime_error(format(
+        "compute pipeline takes {} buffers and {} images, got {} and {}",
+        num_bindings(false),
+        num_bindings(true),
+        buffers.size(),
+        images.size()
+      ));
+    }
+
+    VkDescriptorSetAllocateInfo alloc_info{};
+    alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    alloc_info.descriptorPool = pool;
+    alloc_info.descriptorSetCount = 1;
+    alloc_info.pSetLayouts = &set_layout;
+
+    VkDescriptorSet set;
+    if (vkAllocateDescriptorSets(device->get(), &alloc_info, &set) != VK_SUCCESS) {
+      throw runtime_error("failed to allocate descriptor set, out of max_sets?");
+    }
+
+    u32 num_writes = static_cast<u32>(bindings.size());
+    vector<VkWriteDescriptorSet> writes(num_writes);
+    u32 next_buffer = 0;
+    u32 next_image = 0;
+    for (u32 i = 0; i < num_writes; ++i) {
+      writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+      writes[i].dstSet = set;
+      writes[i].dstBinding = i;
+      writes[i].descriptorCount = 1;
+      writes[i].descriptorType = bindings[i];
+      if (is_image(bindings[i])) {
+        writes[i].pImageInfo = &images[next_image++];
+      } else {
+        writes[i].pBufferInfo = &buffers[next_buffer++];
+      }
+    }
+    vkUpdateDescriptorSets(device->get(), num_writes, writes.data(), 0, nullptr);
+
+    return set;
+  }
+
+  // must be recorded outside of a render pass. push is push_size bytes (or null if there are none)
+  void dispatch(
+    VkCommandBuffer buffer,
+    VkDescriptorSet set,
+    const void* push,
+    u32 groups_x,
+    u32 groups_y = 1,
+    u32 groups_z = 1
+  ) {
+    vkCmdBindPipeline(buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+    vkCmdBindDescriptorSets(buffer, VK_PIPELINE_BIND_POINT_COMPUTE, layout, 0, 1, &set, 0, nullptr);
+    if (push_size > 0) {
+      vkCmdPushConstants(buffer, layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, push_size, push);
+    }
+    vkCmdDispatch(buffer, groups_x, groups_y, groups_z);
+  }
+
+  // num of groups of group_size invocations covering n, the shader must skip the ones past the end
+  static u32 groups(u32 n, u32 group_size) {
+    return (n + group_size - 1) / group_size;
+  }
+
+  // orders what this pass writes (in the shader) before what reads it next, e.g. vertex input or
+  // indirect draws. Recorded after dispatch(), outside of a render pass
+  static void barrier(VkCommandBuffer buffer, VkPipelineStageFlags dst_stage, VkAccessFlags dst_access) {
+    VkMemoryBarrier written{};
+    written.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    written.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    written.dstAccessMask = dst_access;
+    vkCmdPipelineBarrier(
+      buffer,
+      VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+      dst_stage,
+      0,
+      1, &written,
+      0, nullptr,
+      0, nullptr
+    );
+  }
+};
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <mutex>
+#include <deque>
+#include <functional>
+
+#include "utils.h"
+
+using namespace std;
+using namespace utils;
+
+/***
+ * destroys vulkan objects once the GPU is done w/ them, instead of when their wrapper goes away.
+ * Dropping a buffer / pipeline / ... that frames in flight might still be using is then fine, no
+ * wait_idle needed.
+ *
+ * every submitted frame gets a serial (see submitted()). Objects are tagged w/ the serial of the
+ * next frame to be submitted, any frame that could have used them was submitted before or w/ it.
+ * Once the fence of that frame is known to be signaled (see retire()), they're destroyed. W/ a
+ * timeline semaphore the serials are the values it's signaled w/, so whatever it reads is the frame
+ * to retire (see LogicalDevice::graphics_timeline).
+ *
+ * assumes frames complete in submission order, i.e. a single queue. Thread safe, wrappers can be
+ * dropped from any thread (e.g. a failed compile on a PipelineCompiler worker)
+ */
+class DeletionQueue {
+  struct Entry {
+    uint64_t frame;
+    function<void()> destroy;
+  };
+
+  mutable mutex queue_mutex;
+  deque<Entry> entries; // in frame order
+  uint64_t next_frame = 1; // serial of the next frame to be submitted
+  uint64_t retired_frame = 0; // this frame and all the ones before are done on the GPU
+
+  // caller holds the lock
+  void flush(uint64_t up_to_frame) {
+    while (!entries.empty() && entries.front().frame <= up_to_frame) {
+      entries.front().destroy();
+      entries.pop_front();
+      destroyed += 1;
+    }
+  }
+
+public:
+  u32 destroyed = 0;
+
+  ~DeletionQueue() {
+    if (!entries.empty()) {
+      cout << format("~DeletionQueue(): {} objects were never destroyed\n", entries.size());
+    }
+  }
+
+  // destroy must only capture handles (and whatever frees them), not the wrapper being destroyed
+  void push(function<void()> destroy) {
+    lock_guard lock(queue_mutex);
+    entries.push_back({ next_frame, std::move(destroy) });
+  }
+
+  // call when submitting a frame, the serial to pass to retire() once it's done. Taken before the
+  // submission w/ a timeline semaphore, it's the value to signal
+  uint64_t submitted() {
+    lock_guard lock(queue_mutex);
+    return next_frame++;
+  }
+
+  // frame (a serial from submitted()) is done, and so are all the ones before it
+  void retire(uint64_t frame) {
+    lock_guard lock(queue_mutex);
+    retired_frame = (std::max)(retired_frame, frame);
+    flush(retired_frame);
+  }
+
+  // the device is idle, nothing submitted is still running. Everything queued so far goes, even
+  // what's tagged w/ the next frame, since that one wasn't submitted yet
+  void retire_all() {
+    lock_guard lock(queue_mutex);
+    retired_frame = next_frame - 1;
+    flush(next_frame);
+  }
+
+  string to_str() const {
+    lock_guard lock(queue_mutex);
+    return format("deletion queue: {} destroyed, {} pending", destroyed, entries.size());
+  }
+};
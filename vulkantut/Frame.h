@@ -1,12 +1,22 @@
 #pragma once
 
+#include <cassert>
+
 #include "LogicalDevice.h"
 #include "Sema.h"
 #include "Fence.h"
 #include "RenderPass.h"
 #include "Swapchain.h"
+#include "Framebuffer.h"
 #include "GraphicsPipeline.h"
 #include "VertexBuffer.h"
+#include "IndexBuffer.h"
+#include "GpuTimer.h"
+#include "Command.h"
+#include "CommandCache.h"
+#include "WorkerPool.h"
+#include "GpuCulling.h"
+#include "VertexAnimator.h"
 
 #include "vulkan_include.h"
 #include "utils.h"
@@ -15,34 +25,428 @@
 using namespace std;
 using namespace utils;
 
+/***
+ * the per-frame path (wait, draw*, record) is called every frame and must not allocate nor copy
+ * ptrs (each copy is an atomic inc / dec): everything is passed by reference, see alloc_audit()
+ * in main.cpp
+ */
 class Frame {
   ptr<LogicalDevice> device;
 
   ptr<Sema> image_available_sema;
   ptr<Sema> render_finished_sema;
-  ptr<Fence> inflight_fence;
+  ptr<Fence> inflight_fence; // null w/ the device's graphics_timeline, see submit()
+  u32 qfam_index;
+  ptr<Command> command; // the frame's own pool w/ its one command buffer
+  uint64_t submitted_frame = 0; // serial of the last submission, see DeletionQueue
+
+  // one pool (w/ one secondary buffer) per worker, see record_secondaries()
+  vector<ptr<Command>> secondary_commands;
+  vector<VkCommandBuffer> secondary_buffers;
+  ptr<GpuTimer> timer; // null if timings weren't requested / aren't supported
+
+  // everything inside the render pass: pipeline, dynamic state, buffers and draw calls
+  // [first, first + count) of geometry.draws
+  static void record_draws(
+    VkCommandBuffer buffer,
+    VkExtent2D extent,
+    GraphicsPipeline& pipeline,
+    const Geometry& geometry,
+    u32 first,
+    u32 count
+  ) {
+    vkCmdBindPipeline(buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline.get());
+
+    // A viewport basically describes the region of the framebuffer that the
+    // output will be rendered to. This will almost always be (0, 0) to (width,
+    // height)
+    VkViewport viewport{};
+    viewport.x = 0.0f;
+    viewport.y = 0.0f;
+    viewport.width = static_cast<float>(extent.width);
+    viewport.height = static_cast<float>(extent.height);
+    viewport.minDepth = 0.0f;
+    viewport.maxDepth = 1.0f;
+    vkCmdSetViewport(buffer, 0, 1, &viewport);
+
+    // While viewports define the transformation from the image to the
+    // framebuffer, scissor rectangles define in which regions pixels will
+    // actually be stored. Any pixels outside the scissor rectangles will be
+    // discarded by the rasterizer. 
+    VkRect2D scissor{};
+    scissor.offset = { 0, 0 };
+    scissor.extent = extent;
+    vkCmdSetScissor(buffer, 0, 1, &scissor);
+    
+    VkBuffer verticess[] = { geometry.vertices.buffer };
+    VkDeviceSize offsets[] = { geometry.vertices.offset };
+    vkCmdBindVertexBuffers(buffer, 0, 1, verticess, offsets);
+
+    if (geometry.culling) {
+      // a single indirect draw of the visible instances (it binds those), recorded by whoever gets
+      // the first draw
+      if (first == 0 && count > 0) {
+        vkCmdBindIndexBuffer(buffer, geometry.indices.buffer, geometry.indices.offset, geometry.indices.type);
+        geometry.culling->record_draw(buffer);
+      }
+      return;
+    }
+
+    if (geometry.instances.count > 0) {
+      vkCmdBindVertexBuffers(buffer, 1, 1, &geometry.instances.buffer, &geometry.instances.offset);
+    }
+
+    // draw i gets instances [i * per_draw, (i + 1) * per_draw), w/o instances it's 1 each
+    assert(geometry.draws >= 1);
+    u32 per_draw = 1;
+    if (geometry.instances.count > 0) {
+      per_draw = (geometry.instances.count + geometry.draws - 1) / geometry.draws;
+    }
+
+    auto instances = [&](u32 draw, u32& first_instance) {
+      if (geometry.instances.count == 0) {
+        first_instance = 0;
+        return 1u;
+      }
+      first_instance = (std::min)(draw * per_draw, geometry.instances.count);
+      return (std::min)(per_draw, geometry.instances.count - first_instance);
+    };
+
+    if (geometry.indices.count > 0) {
+      vkCmdBindIndexBuffer(buffer, geometry.indices.buffer, geometry.indices.offset, geometry.indices.type);
+      for (u32 i = first; i < first + count; ++i) {
+        u32 first_instance;
+        u32 instance_count = instances(i, first_instance);
+        vkCmdDrawIndexed(buffer, geometry.indices.count, instance_count, 0, 0, first_instance);
+      }
+    } else {
+      for (u32 i = first; i < first + count; ++i) {
+        u32 first_instance;
+        u32 instance_count = instances(i, first_instance);
+        vkCmdDraw(buffer, geometry.vertices.count, instance_count, 0, first_instance);
+      }
+    }
+  }
+
+  // geometry.draws split over the workers, each recording into a secondary buffer from its own
+  // pool. Pools are reset as a whole, the frame's previous submission is done by now (see wait())
+  void record_secondaries(
+    RenderPass& renderpass,
+    Framebuffer& framebuffer,
+    VkExtent2D extent,
+    GraphicsPipeline& pipeline,
+    const Geometry& geometry
+  ) {
+    u32 num_threads = workers->size();
+    if (secondary_commands.size() != num_threads) {
+      secondary_commands.clear();
+      secondary_buffers.clear();
+      for (u32 i = 0; i < num_threads; ++i) {
+        secondary_commands.push_back(mk_ptr<Command>(device, qfam_index, 1, VK_COMMAND_BUFFER_LEVEL_SECONDARY));
+        secondary_buffers.push_back(secondary_commands.back()->get_buffer(0));
+      }
+    }
+
+    u32 per_thread = (geometry.draws + num_threads - 1) / num_threads;
+
+    auto job = [&](u32 thread_index) {
+      Command& pool = *secondary_commands[thread_index];
+      VkCommandBuffer buffer = secondary_buffers[thread_index];
+      pool.reset();
+
+      // secondary buffers executed inside a render pass must say which one (and which subpass)
+      VkCommandBufferInheritanceInfo inheritance{};
+      inheritance.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+      inheritance.renderPass = renderpass.get();
+      inheritance.subpass = 0;
+      inheritance.framebuffer = framebuffer.buffer;
+
+      VkCommandBufferBeginInfo begin_info{};
+      begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+      begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+      begin_info.pInheritanceInfo = &inheritance;
+
+      if (vkBeginCommandBuffer(buffer, &begin_info) != VK_SUCCESS) {
+        throw runtime_error("failed to begin recording secondary command buffer");
+      }
+
+      u32 first = (std::min)(thread_index * per_thread, geometry.draws);
+      record_draws(buffer, extent, pipeline, geometry, first, (std::min)(per_thread, geometry.draws - first));
+
+      if (vkEndCommandBuffer(buffer) != VK_SUCCESS) {
+        throw runtime_error("failed to record secondary command buffer");
+      }
+    };
+
+    workers->run(job);
+  }
+
+  void record(
+    VkCommandBuffer buffer,
+    RenderPass& renderpass,
+    Framebuffer& framebuffer,
+    VkExtent2D extent,
+    GraphicsPipeline& pipeline,
+    const Geometry& geometry,
+    bool timed, // w/ timestamps, only for buffers that are submitted once
+    bool parallel // draws recorded by the workers, see record_secondaries()
+  ) {
+    GpuTimer* timer = timed ? this->timer.get() : nullptr;
+
+    if (parallel) {
+      record_secondaries(renderpass, framebuffer, extent, pipeline, geometry);
+    }
+
+    vkResetCommandBuffer(buffer, 0);
+
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = 0; // Optional
+    beginInfo.pInheritanceInfo = nullptr; // Optional
+
+    if (vkBeginCommandBuffer(buffer, &beginInfo) != VK_SUCCESS) {
+      throw std::runtime_error("failed to begin recording command buffer!");
+    }
+
+    if (timer) {
+      timer->reset(buffer);
+      timer->write(buffer, GpuTimer::CMD_BEGIN);
+    }
+
+    // compute work must happen outside of the render pass
+    if (geometry.animator) {
+      geometry.animator->record(buffer);
+    }
+    if (geometry.culling) {
+      geometry.culling->record_cull(buffer, geometry.indices.count);
+    }
+
+    if (timer) {
+      timer->write(buffer, GpuTimer::PASS_BEGIN);
+    }
+
+    VkRenderPassBeginInfo renderPassInfo{};
+    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+    renderPassInfo.renderPass = renderpass.get();
+    renderPassInfo.framebuffer = framebuffer.buffer;
+
+    renderPassInfo.renderArea.offset = { 0, 0 };
+    renderPassInfo.renderArea.extent = extent;
+
+    VkClearValue clearColor = { {{0.0f, 0.0f, 0.0f, 1.0f}} };
+    renderPassInfo.clearValueCount = 1;
+    renderPassInfo.pClearValues = &clearColor;
+
+    if (parallel) {
+      // a pass w/ SECONDARY_COMMAND_BUFFERS contents can only execute them, no timestamps inside,
+      // so "draw" is timed around the whole pass
+      if (timer) {
+        timer->write(buffer, GpuTimer::DRAW_BEGIN);
+      }
+
+      vkCmdBeginRenderPass(buffer, &renderPassInfo, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+      vkCmdExecuteCommands(buffer, static_cast<u32>(secondary_buffers.size()), secondary_buffers.data());
+      vkCmdEndRenderPass(buffer);
+
+      if (timer) {
+        timer->write(buffer, GpuTimer::DRAW_END);
+      }
+    } else {
+      vkCmdBeginRenderPass(buffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+      if (timer) {
+        timer->write(buffer, GpuTimer::DRAW_BEGIN);
+      }
+
+      record_draws(buffer, extent, pipeline, geometry, 0, geometry.draws);
+
+      if (timer) {
+        timer->write(buffer, GpuTimer::DRAW_END);
+      }
+
+      vkCmdEndRenderPass(buffer);
+    }
+
+    if (timer) {
+      timer->write(buffer, GpuTimer::PASS_END);
+      timer->write(buffer, GpuTimer::CMD_END);
+    }
+
+    if (vkEndCommandBuffer(buffer) != VK_SUCCESS) {
+      throw std::runtime_error("failed to record command buffer!");
+    }
+  }
+
+  // submits buffer to the graphics queue and gives it the frame's new serial (see DeletionQueue).
+  // W/ the device's graphics_timeline its completion is signaled on that, as the serial, otherwise
+  // on the frame's fence. wait_sema / signal_sema are the binary semaphores presentation needs,
+  // VK_NULL_HANDLE if there's no swapchain
+  void submit(VkCommandBuffer buffer, VkSemaphore wait_sema, VkSemaphore signal_sema) {
+    TimelineSemaphore* timeline = device->graphics_timeline.get();
+    uint64_t serial = device->deletion_queue->submitted();
+
+    VkSubmitInfo submit_info{};
+    submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submit_info.commandBufferCount = 1;
+    submit_info.pCommandBuffers = &buffer;
+
+    VkPipelineStageFlags wait_stage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    if (wait_sema != VK_NULL_HANDLE) {
+      submit_info.waitSemaphoreCount = 1;
+      submit_info.pWaitSemaphores = &wait_sema;
+      submit_info.pWaitDstStageMask = &wait_stage;
+    }
+
+    // values are ignored for binary semaphores, but there must be one per semaphore
+    VkSemaphore signal_semas[2];
+    uint64_t signal_values[2];
+    u32 num_signals = 0;
+    if (signal_sema != VK_NULL_HANDLE) {
+      signal_semas[num_signals] = signal_sema;
+      signal_values[num_signals++] = 0;
+    }
+
+    VkTimelineSemaphoreSubmitInfo timeline_info{};
+    uint64_t wait_value = 0;
+    VkFence fence = VK_NULL_HANDLE;
+
+    if (timeline) {
+      signal_semas[num_signals] = timeline->get();
+      signal_values[num_signals++] = serial;
+
+      timeline_info.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+      timeline_info.waitSemaphoreValueCount = submit_info.waitSemaphoreCount;
+      timeline_info.pWaitSemaphoreValues = &wait_value;
+      timeline_info.signalSemaphoreValueCount = num_signals;
+      timeline_info.pSignalSemaphoreValues = signal_values;
+      submit_info.pNext = &timeline_info;
+    } else {
+      // only reset if we're submitting work
+      // (see "Fixing a Deadlock" @ https://vulkan-tutorial.com/Drawing_a_triangle/Swap_chain_recreation)
+      fence = inflight_fence->get();
+      device->reset_fence(fence);
+    }
+
+    submit_info.signalSemaphoreCount = num_signals;
+    submit_info.pSignalSemaphores = signal_semas;
+
+    if (vkQueueSubmit(device->graphics_q, 1, &submit_info, fence) != VK_SUCCESS) {
+      throw std::runtime_error("failed to submit draw command buffer!");
+    }
+    submitted_frame = serial;
+  }
+
+  // the command buffer to submit: the frame's own, recorded right now, or w/ a cache, the one
+  // recorded for the framebuffer (re-recorded only if stale). Replayed buffers aren't timed, the
+  // timestamps would go to whichever frame recorded them
+  VkCommandBuffer commands(
+    RenderPass& renderpass,
+    Framebuffer& framebuffer,
+    u32 framebuffer_index,
+    VkExtent2D extent,
+    GraphicsPipeline& pipeline,
+    const Geometry& geometry,
+    CommandCache* cache
+  ) {
+    recorded_at = chrono::steady_clock::now();
+
+    if (!cache) {
+      VkCommandBuffer buffer = command->get_buffer(0);
+      bool parallel = workers && workers->size() > 0;
+      record(buffer, renderpass, framebuffer, extent, pipeline, geometry, true, parallel);
+      record_ms = chrono::duration<double, milli>(chrono::steady_clock::now() - *recorded_at).count();
+      return buffer;
+    }
+
+    bool stale;
+    VkCommandBuffer buffer = cache->get(
+      framebuffer_index,
+      { framebuffer.buffer, pipeline.get(), extent, geometry },
+      stale
+    );
+
+    // the cached primary can't reference the per-frame secondaries, they're re-recorded every frame
+    if (stale) {
+      record(buffer, renderpass, framebuffer, extent, pipeline, geometry, false, false);
+    }
+    record_ms = chrono::duration<double, milli>(chrono::steady_clock::now() - *recorded_at).count();
+    return buffer;
+  }
 
 public:
+  // when the frame's last submission was recorded, unset once it's known to be done (see retire())
+  optional<chrono::steady_clock::time_point> recorded_at;
+  double record_ms = 0.0; // CPU time spent recording it
+
+  // if set (and not empty), draws are recorded in parallel into secondary command buffers.
+  // Can change between frames, the old secondary pools are destroyed once they are done
+  WorkerPool* workers = nullptr;
+
+  // qfam_index: family of the queue the frame is submitted to (graphics)
+  // timings: where to accumulate the GPU time of this frame's submissions, null to disable
   Frame(
-    ptr<LogicalDevice> device
+    ptr<LogicalDevice> device,
+    u32 qfam_index,
+    ptr<GpuTimings> timings = nullptr
   ) : device(device)
+    , qfam_index(qfam_index)
   { 
     image_available_sema = mk_ptr<Sema>(device);
     render_finished_sema = mk_ptr<Sema>(device);
-    inflight_fence = mk_ptr<Fence>(device);
+    if (!device->graphics_timeline) {
+      inflight_fence = mk_ptr<Fence>(device);
+    }
+    command = mk_ptr<Command>(device, qfam_index, 1);
+
+    if (timings && GpuTimer::supported(device)) {
+      timer = mk_ptr<GpuTimer>(device, timings);
+    }
   }
 
   ~Frame() {
     cout << "~Frame()\n";
   }
 
+  // blocks until this frame's previous submission is done. After this, whatever that submission
+  // used (e.g. the frame's RingBuffer region) can be reused. draw() calls it anyway, calling it
+  // again is cheap since the fence is already signaled (or w/ a timeline, a value comparison)
+  void wait() {
+    if (TimelineSemaphore* timeline = device->graphics_timeline.get()) {
+      timeline->wait(submitted_frame);
+      // whatever else finished by now goes too, not just this frame
+      device->deletion_queue->retire(timeline->completed());
+    } else {
+      device->wait_fence(inflight_fence->get());
+      device->deletion_queue->retire(submitted_frame);
+    }
+
+    // previous submission of this frame is done, its timestamps can be read w/o stalling
+    if (timer) {
+      timer->collect();
+    }
+  }
+
+  // wait()s and returns how long ago the previous submission was recorded (ms), i.e. how long it
+  // took to get through the GPU as far as the CPU can tell. Nothing if there was none
+  optional<double> retire() {
+    wait();
+
+    if (!recorded_at) {
+      return nullopt;
+    }
+
+    double res = chrono::duration<double, milli>(chrono::steady_clock::now() - *recorded_at).count();
+    recorded_at.reset();
+    return res;
+  }
+
   VkResult draw(
-    ptr<RenderPass> renderpass,
-    ptr<Swapchain> swapchain,
-    ptr<GraphicsPipeline> pipeline,
-    vector<ptr<Framebuffer>> framebuffers,
-    VkCommandBuffer buffer,
-    ptr<VertexBuffer> vertices
+    RenderPass& renderpass,
+    Swapchain& swapchain,
+    GraphicsPipeline& pipeline,
+    const vector<ptr<Framebuffer>>& framebuffers,
+    const Geometry& geometry,
+    CommandCache* cache = nullptr // one buffer per swapchain image, see CommandCache
   ) {
     // At a high level, rendering a frame in Vulkan consists of a common set of steps:
     // - Wait for the previous frame to finish
@@ -51,13 +455,12 @@ public:
     // - Submit the recorded command buffer
     // - Present the swap chain image
 
-    vector<VkFence> fences { inflight_fence->get() };
-    device->wait_fences(fences);
+    wait();
 
     uint32_t image_index;
     VkResult res = vkAcquireNextImageKHR(
       device->get(),
-      swapchain->get(),
+      swapchain.get(),
       UINT64_MAX,
       image_available_sema->get(),
       VK_NULL_HANDLE,
@@ -69,78 +472,81 @@ public:
       return res;
     }
 
-    // only reset if we're submitting work 
-    // (see "Fixing a Deadlock" @ https://vulkan-tutorial.com/Drawing_a_triangle/Swap_chain_recreation)
-    device->reset_fences(fences);  
-
-    vkResetCommandBuffer(buffer, 0);
-
-    VkCommandBufferBeginInfo beginInfo{};
-    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-    beginInfo.flags = 0; // Optional
-    beginInfo.pInheritanceInfo = nullptr; // Optional
-
-    if (vkBeginCommandBuffer(buffer, &beginInfo) != VK_SUCCESS) {
-      throw std::runtime_error("failed to begin recording command buffer!");
+    // some other frame in flight might still be rendering to this image (more frames than images,
+    // or images acquired out of order). Wait for that one, not for all of them
+    if (device->graphics_timeline) {
+      device->graphics_timeline->wait(swapchain.images_inflight_frames[image_index]);
+    } else {
+      VkFence& image_fence = swapchain.images_inflight[image_index];
+      if (image_fence != VK_NULL_HANDLE && image_fence != inflight_fence->get()) {
+        device->wait_fence(image_fence);
+      }
+      image_fence = inflight_fence->get();
     }
 
-    VkRenderPassBeginInfo renderPassInfo{};
-    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-    renderPassInfo.renderPass = renderpass->get();
-    renderPassInfo.framebuffer = framebuffers[image_index]->buffer;
-
-    renderPassInfo.renderArea.offset = { 0, 0 };
-    renderPassInfo.renderArea.extent = swapchain->extent;
-
-    VkClearValue clearColor = { {{0.0f, 0.0f, 0.0f, 1.0f}} };
-    renderPassInfo.clearValueCount = 1;
-    renderPassInfo.pClearValues = &clearColor;
-
-    vkCmdBeginRenderPass(buffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
-    vkCmdBindPipeline(buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline->get());
-    
-    VkBuffer verticess[] = { vertices->get() };
-    VkDeviceSize offsets[] = { 0 };
-    vkCmdBindVertexBuffers(buffer, 0, 1, verticess, offsets);
+    VkCommandBuffer buffer = commands(
+      renderpass,
+      *framebuffers[image_index],
+      image_index,
+      swapchain.extent,
+      pipeline,
+      geometry,
+      cache
+    );
 
-    vkCmdDraw(buffer, vertices->size(), 1, 0, 0);
-    vkCmdEndRenderPass(buffer);
+    // presentation can only wait on / signal binary semaphores, the timeline is only for the CPU
+    VkSemaphore render_finished = render_finished_sema->get();
+    submit(buffer, image_available_sema->get(), render_finished);
+    swapchain.images_inflight_frames[image_index] = submitted_frame;
 
-    if (vkEndCommandBuffer(buffer) != VK_SUCCESS) {
-      throw std::runtime_error("failed to record command buffer!");
-    }
-
-    VkSubmitInfo submitInfo{};
-    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-
-    VkSemaphore waitSemaphores[] = { image_available_sema->get() };
-    VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
-    submitInfo.waitSemaphoreCount = 1;
-    submitInfo.pWaitSemaphores = waitSemaphores;
-    submitInfo.pWaitDstStageMask = waitStages;
-    submitInfo.commandBufferCount = 1;
-    submitInfo.pCommandBuffers = &buffer;
-
-    VkSemaphore signalSemaphores[] = { render_finished_sema->get() };
-    submitInfo.signalSemaphoreCount = 1;
-    submitInfo.pSignalSemaphores = signalSemaphores;
-
-    if (vkQueueSubmit(device->graphics_q, 1, &submitInfo, inflight_fence->get()) != VK_SUCCESS) {
-      throw std::runtime_error("failed to submit draw command buffer!");
+    if (timer && !cache) {
+      timer->submitted();
     }
 
     VkPresentInfoKHR presentInfo{};
     presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
 
     presentInfo.waitSemaphoreCount = 1;
-    presentInfo.pWaitSemaphores = signalSemaphores;
+    presentInfo.pWaitSemaphores = &render_finished;
 
-    VkSwapchainKHR swapChains[] = { swapchain->get() };
+    VkSwapchainKHR swapChains[] = { swapchain.get() };
     presentInfo.swapchainCount = 1;
     presentInfo.pSwapchains = swapChains;
 
     presentInfo.pImageIndices = &image_index;
 
+    // tag it, so it can be waited for (see Swapchain::wait_presented)
+    VkPresentIdKHR present_id{};
+    if (device->present_wait) {
+      swapchain.present_id += 1;
+      present_id.sType = VK_STRUCTURE_TYPE_PRESENT_ID_KHR;
+      present_id.swapchainCount = 1;
+      present_id.pPresentIds = &swapchain.present_id;
+      presentInfo.pNext = &present_id;
+    }
+
     return vkQueuePresentKHR(device->present_q, &presentInfo);
   }
+
+  // headless version of draw(): no swapchain, so nothing to acquire and nothing to present. 
+  // renders into a device-owned image (see Image), the caller picks which framebuffer this frame 
+  // uses, which should not be shared w/ other frames in flight since there's no semaphore ordering them
+  void draw_offscreen(
+    RenderPass& renderpass,
+    Framebuffer& framebuffer,
+    u32 framebuffer_index,
+    VkExtent2D extent,
+    GraphicsPipeline& pipeline,
+    const Geometry& geometry,
+    CommandCache* cache = nullptr // one buffer per framebuffer, see CommandCache
+  ) {
+    wait();
+
+    VkCommandBuffer buffer = commands(renderpass, framebuffer, framebuffer_index, extent, pipeline, geometry, cache);
+    submit(buffer, VK_NULL_HANDLE, VK_NULL_HANDLE);
+
+    if (timer && !cache) {
+      timer->submitted();
+    }
+  }
 };
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <thread>
+
+#include "utils.h"
+
+using namespace std;
+using namespace utils;
+
+/***
+ * caps the frame rate on the CPU side: wait() returns at most fps times a second. Frames are then
+ * started at a steady pace instead of as soon as there's a free frame in flight, so they don't pile
+ * up in the queue (latency) and the frame times don't jitter w/ the queue filling / draining.
+ *
+ * sleeps most of the interval and yields the rest, sleep granularity can be a whole millisecond
+ * (or worse, on Windows)
+ */
+class FrameLimiter {
+  chrono::steady_clock::duration interval;
+  chrono::steady_clock::time_point next;
+
+public:
+  const double fps;
+
+  FrameLimiter(double fps)
+    : interval(chrono::duration_cast<chrono::steady_clock::duration>(chrono::duration<double>(1.0 / fps)))
+    , next(chrono::steady_clock::now())
+    , fps(fps)
+  {}
+
+  void wait() {
+    auto now = chrono::steady_clock::now();
+    if (now < next) {
+      auto spin = chrono::milliseconds(2);
+      if (next - now > spin) {
+        this_thread::sleep_for(next - now - spin);
+      }
+      while (chrono::steady_clock::now() < next) {
+        this_thread::yield();
+      }
+    }
+
+    // a late frame doesn't make the next ones early, the pace restarts from now
+    next = (std::max)(next, now) + interval;
+  }
+};
@@ -51,6 +51,8 @@ public:
 
   ~Framebuffer() {
     cout << "~Framebuffer()\n";
-    vkDestroyFramebuffer(device->get(), buffer, nullptr);
+    device->deletion_queue->push([device = device->get(), buffer = buffer]() {
+      vkDestroyFramebuffer(device, buffer, nullptr);
+    });
   }
 };
@@ -0,0 +1,140 @@
+#pragma once
+
+#include "LogicalDevice.h"
+#include "Buffer.h"
+#include "ComputePipeline.h"
+#include "InstanceBuffer.h"
+
+#include "vulkan_include.h"
+#include "utils.h"
+#include "vk_utils.h"
+
+using namespace std;
+using namespace utils;
+
+/***
+ * GPU-driven drawing of instanced, indexed geometry: a compute pass culls the instances against a
+ * rect (the viewport by default) and packs the visible ones into a buffer of their own, counting
+ * them in the instanceCount of a single VkDrawIndexedIndirectCommand. One indirect draw (drawCount
+ * 1) then draws that buffer as its per-instance vertex buffer. The CPU records the same handful of
+ * commands whatever the num of instances.
+ *
+ * a single command needs neither the multiDrawIndirect feature nor VK_KHR_draw_indirect_count
+ *
+ * the buffers are shared by the frames in flight, record_cull() waits for the previous frame's
+ * indirect / vertex reads before overwriting them
+ */
+class GpuCulling {
+  // matches cull.comp
+  struct Push {
+    float cull_min[2];
+    float cull_max[2];
+    u32 num_instances;
+  };
+
+  static constexpr u32 group_size = 64; // local_size_x of cull.comp, through SPEC_WORKGROUP_SIZE
+
+  ptr<LogicalDevice> device;
+  ptr<ComputePipeline> pipeline;
+  ptr<Buffer> visible; // the visible instances, packed at the front
+  ptr<Buffer> command; // a single VkDrawIndexedIndirectCommand
+  VkDescriptorSet set;
+  u32 num_instances;
+
+public:
+  float cull_min[2] = { -1.0f, -1.0f };
+  float cull_max[2] = { 1.0f, 1.0f };
+
+  // instances must be a storage buffer too (see InstanceBuffer), of Instance. Each one's bounds are
+  // its offset +- scale, i.e. meshes fit in [-1, 1]
+  GpuCulling(ptr<LogicalDevice> device, InstanceSpan instances)
+    : device(device)
+    , num_instances(instances.count)
+  {
+    SpecConstants constants;
+    constants.set(SPEC_WORKGROUP_SIZE, group_size);
+    pipeline = mk_ptr<ComputePipeline>(
+      device,
+      "shaders/cull_comp.spv",
+      3,
+      static_cast<u32>(sizeof(Push)),
+      1,
+      &constants
+    );
+
+    VkDeviceSize instances_size = sizeof(Instance) * (std::max)(num_instances, 1u);
+    visible = mk_ptr<Buffer>(
+      device,
+      instances_size,
+      VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
+    );
+    command = mk_ptr<Buffer>(
+      device,
+      sizeof(VkDrawIndexedIndirectCommand),
+      VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
+    );
+
+    set = pipeline->make_set({
+      { instances.buffer, instances.offset, instances_size },
+      { visible->get(), 0, VK_WHOLE_SIZE },
+      { command->get(), 0, VK_WHOLE_SIZE },
+    });
+  }
+
+  // outside of the render pass, before it. index_count of the mesh drawn, it's passed every time
+  // so the command never refers to an old one
+  void record_cull(VkCommandBuffer buffer, u32 index_count) {
+    // the previous frame's draw might still be reading the command / visible instances (write after
+    // read, an execution dependency is enough)
+    vkCmdPipelineBarrier(
+      buffer,
+      VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+      VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+      0,
+      0, nullptr,
+      0, nullptr,
+      0, nullptr
+    );
+
+    // instanceCount is counted up by the shader
+    VkDrawIndexedIndirectCommand reset{ index_count, 0, 0, 0, 0 };
+    vkCmdUpdateBuffer(buffer, command->get(), 0, sizeof(reset), &reset);
+
+    VkMemoryBarrier cleared{};
+    cleared.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    cleared.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    cleared.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    vkCmdPipelineBarrier(
+      buffer,
+      VK_PIPELINE_STAGE_TRANSFER_BIT,
+      VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+      0,
+      1, &cleared,
+      0, nullptr,
+      0, nullptr
+    );
+
+    Push push{
+      { cull_min[0], cull_min[1] },
+      { cull_max[0], cull_max[1] },
+      num_instances
+    };
+    pipeline->dispatch(buffer, set, &push, ComputePipeline::groups(num_instances, group_size));
+    ComputePipeline::barrier(
+      buffer,
+      VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+      VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT
+    );
+  }
+
+  // inside the render pass, w/ the pipeline, vertex and index buffers bound. Binds the visible
+  // instances as the per-instance vertex buffer (binding 1)
+  void record_draw(VkCommandBuffer buffer) {
+    VkBuffer instances = visible->get();
+    VkDeviceSize offset = 0;
+    vkCmdBindVertexBuffers(buffer, 1, 1, &instances, &offset);
+    vkCmdDrawIndexedIndirect(buffer, command->get(), 0, 1, sizeof(VkDrawIndexedIndirectCommand));
+  }
+};
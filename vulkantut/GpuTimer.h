@@ -0,0 +1,164 @@
+#pragma once
+
+#include <array>
+
+#include "LogicalDevice.h"
+
+#include "vulkan_include.h"
+#include "utils.h"
+#include "vk_utils.h"
+
+using namespace std;
+using namespace utils;
+
+/***
+ * GPU time (ms) of the last N frames, split per pass. Shared by all the frames' GpuTimers
+ */
+struct GpuTimings {
+  RollingStats cmd;  // whole command buffer
+  RollingStats pass; // render pass
+  RollingStats draw; // draw call(s)
+
+  void clear() {
+    cmd.clear();
+    pass.clear();
+    draw.clear();
+  }
+
+  string to_str() const {
+    auto line = [](const char* name, const RollingStats& stats) {
+      return format(
+        "\t{:<5} mean {:.3f} ms, p50 {:.3f} ms, p99 {:.3f} ms\n",
+        name,
+        stats.mean(),
+        stats.p50(),
+        stats.p99()
+      );
+    };
+
+    return format("gpu timings ({} frames):\n", cmd.size()) +
+      line("cmd", cmd) +
+      line("pass", pass) +
+      line("draw", draw);
+  }
+};
+
+/***
+ * per-frame pool of timestamp queries written around the interesting parts of the command buffer.
+ *
+ * results are read back a frame late: collect() is called after the frame's inflight fence was waited
+ * on, at which point the previous submission is done and its queries are available, so reading them
+ * never stalls.
+ */
+class GpuTimer {
+public:
+  enum Query : u32 {
+    CMD_BEGIN,
+    PASS_BEGIN,
+    DRAW_BEGIN,
+    DRAW_END,
+    PASS_END,
+    CMD_END,
+    NUM_QUERIES
+  };
+
+private:
+  ptr<LogicalDevice> device;
+  ptr<GpuTimings> timings;
+  VkQueryPool pool;
+
+  double ms_per_tick;
+  uint64_t mask; // timestampValidBits of the graphics queue, only those bits of a result count
+  bool pending = false; // submitted but not yet collected
+  array<uint64_t, NUM_QUERIES> results;
+
+  double ms(Query begin, Query end) const {
+    // masked difference, so a counter that wrapped around between the two still gives the right time
+    return ((results[end] - results[begin]) & mask) * ms_per_tick;
+  }
+
+public:
+  // timestamps might not be supported on every queue, e.g. some mobile GPUs. timestampComputeAndGraphics
+  // only promises them on all graphics & compute queues, our graphics queue can have them w/o it
+  static bool supported(ptr<LogicalDevice> device) {
+    return valid_bits(device) > 0;
+  }
+
+  static u32 valid_bits(ptr<LogicalDevice> device) {
+    return device->physical_device->queue_families()[device->graphics_qfam].properties.timestampValidBits;
+  }
+
+  GpuTimer(ptr<LogicalDevice> device, ptr<GpuTimings> timings)
+    : device(device)
+    , timings(timings)
+  {
+    // timestampPeriod == num of nanoseconds per timestamp tick
+    ms_per_tick = device->physical_device->properties().limits.timestampPeriod / 1e6;
+
+    u32 bits = valid_bits(device);
+    mask = bits >= 64 ? ~0ull : (1ull << bits) - 1;
+
+    VkQueryPoolCreateInfo create_info{};
+    create_info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    create_info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    create_info.queryCount = NUM_QUERIES;
+
+    if (vkCreateQueryPool(device->get(), &create_info, nullptr, &pool) != VK_SUCCESS) {
+      throw runtime_error("failed to create query pool");
+    }
+  }
+
+  ~GpuTimer() {
+    vkDestroyQueryPool(device->get(), pool, nullptr);
+  }
+
+  // queries must be reset before they're written, and this must be done outside of a render pass
+  void reset(VkCommandBuffer buffer) {
+    vkCmdResetQueryPool(buffer, pool, 0, NUM_QUERIES);
+  }
+
+  // begin timestamps are written once all previous commands reached the top of the pipe,
+  // end timestamps once they're completely done
+  void write(VkCommandBuffer buffer, Query query) {
+    bool is_end = query == DRAW_END || query == PASS_END || query == CMD_END;
+    vkCmdWriteTimestamp(
+      buffer,
+      is_end ? VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+      pool,
+      query
+    );
+  }
+
+  void submitted() {
+    pending = true;
+  }
+
+  // only call after the fence of the submission that wrote the queries has been signaled
+  void collect() {
+    if (!pending) {
+      return;
+    }
+    pending = false;
+
+    // no WAIT flag, results should already be there. If they aren't (VK_NOT_READY) we drop the sample
+    // rather than stall
+    VkResult res = vkGetQueryPoolResults(
+      device->get(),
+      pool,
+      0,
+      NUM_QUERIES,
+      sizeof(results),
+      results.data(),
+      sizeof(uint64_t),
+      VK_QUERY_RESULT_64_BIT
+    );
+
+    if (res != VK_SUCCESS) {
+      return;
+    }
+
+    timings->cmd.add(ms(CMD_BEGIN, CMD_END));
+    timings->pass.add(ms(PASS_BEGIN, PASS_END));
+    timings->draw.add(ms(DRAW_BEGIN, DRAW_END));
+  }
+};
@@ -1,6 +1,6 @@
 #pragma once
 
-#include "Swapchain.h"
+#include "RenderPass.h"
 #include "Shader.h"
 #include "Vertex.h"
 
@@ -11,69 +11,78 @@
 using namespace std;
 using namespace utils;
 
+/***
+ * everything a GraphicsPipeline is built from, so pipelines can be described up front and built
+ * later / elsewhere (see PipelineCompiler)
+ */
+struct PipelineDesc {
+  ptr<RenderPass> renderpass;
+  VertexLayout vertex_layout = VertexLayout::of<Vertex>(); // of the vertex type of the meshes drawn w/ it
+  string vert_shader = "shaders/vert.spv";
+  string frag_shader = "shaders/frag.spv";
+  SpecConstants vert_constants; // see SpecId
+  SpecConstants frag_constants;
+
+  VkPrimitiveTopology topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+  VkCullModeFlags cull_mode = VK_CULL_MODE_BACK_BIT;
+  VkFrontFace front_face = VK_FRONT_FACE_CLOCKWISE;
+  bool blend = false; // alpha blending
+};
+
 class GraphicsPipeline {
   ptr<LogicalDevice> device;
-  ptr<Swapchain> swapchain;
   ptr<RenderPass> renderpass;
 
   VkPipelineLayout layout;
   VkPipeline pipeline;
 public:
+  double create_ms; // time spent in vkCreateGraphicsPipelines
+
   VkPipeline get() { return pipeline; }
 
-  GraphicsPipeline(ptr<LogicalDevice> device, ptr<Swapchain> swapchain, ptr<RenderPass> renderpass) 
+  // viewport & scissor are dynamic state (set in Frame::record), so the pipeline doesn't depend on
+  // the extent of the render target and survives resizes. It only needs rebuilding when the render
+  // pass (i.e. the format) changes
+  // use_cache == false compiles from scratch, only useful to measure what the cache saves.
+  // Safe to call from several threads at once, see PipelineCompiler
+  GraphicsPipeline(
+    ptr<LogicalDevice> device,
+    const PipelineDesc& desc,
+    bool use_cache = true
+  ) 
     : device(device)
-    , swapchain(swapchain)
-    , renderpass(renderpass)
+    , renderpass(desc.renderpass)
   {
     cout << "GraphicsPipeline() ctor\n";
     // describes the format of the vertex data that will be passed to the vertex shader.
     VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
     vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
     
-    auto bind_desc = Vertex::binding_desc();
-    vertexInputInfo.vertexBindingDescriptionCount = 1;
-    vertexInputInfo.pVertexBindingDescriptions = &bind_desc;
+    const VertexLayout& vertex_layout = desc.vertex_layout;
+    vertexInputInfo.vertexBindingDescriptionCount = static_cast<u32>(vertex_layout.bindings.size());
+    vertexInputInfo.pVertexBindingDescriptions = vertex_layout.bindings.data();
 
-    auto attr_desc = Vertex::attr_desc();
-    vertexInputInfo.vertexAttributeDescriptionCount = attr_desc.size();
-    vertexInputInfo.pVertexAttributeDescriptions = attr_desc.data();
+    vertexInputInfo.vertexAttributeDescriptionCount = static_cast<u32>(vertex_layout.attributes.size());
+    vertexInputInfo.pVertexAttributeDescriptions = vertex_layout.attributes.data();
 
     // describes two things: what kind of geometry will be drawn from the
     // vertices and if primitive restart should be enabled
     VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
     inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-    inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+    inputAssembly.topology = desc.topology;
     inputAssembly.primitiveRestartEnable = VK_FALSE;
 
-    // A viewport basically describes the region of the framebuffer that the
-    // output will be rendered to. This will almost always be (0, 0) to (width,
-    // height)
-    VkViewport viewport{};
-    viewport.x = 0.0f;
-    viewport.y = 0.0f;
-    viewport.width = static_cast<float>(swapchain->extent.width);
-    viewport.height = static_cast<float>(swapchain->extent.height);
-    viewport.minDepth = 0.0f;
-    viewport.maxDepth = 1.0f;
-
-    // While viewports define the transformation from the image to the
-    // framebuffer, scissor rectangles define in which regions pixels will
-    // actually be stored. Any pixels outside the scissor rectangles will be
-    // discarded by the rasterizer. 
-    VkRect2D scissor{};
-    scissor.offset = { 0, 0 };
-    scissor.extent = swapchain->extent;
-
     // ewport and scissor rectangle need to be combined into a viewport state 
     // It is possible to use multiple viewports and scissor rectangles on some
     // graphics cards, so its members reference an array of them.
+    // Both are dynamic state, so only the counts matter here, the actual
+    // rectangles are set w/ vkCmdSetViewport / vkCmdSetScissor when recording
     VkPipelineViewportStateCreateInfo viewportState{};
     viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
     viewportState.viewportCount = 1;
-    viewportState.pViewports = &viewport;
+    viewportState.pViewports = nullptr;
     viewportState.scissorCount = 1;
-    viewportState.pScissors = &scissor;
+    viewportState.pScissors = nullptr;
 
     // rasterizer takes the geometry that is shaped by the vertices from the vertex
     // shader and turns it into fragments to be colored by the fragment shader. It
@@ -92,8 +101,8 @@ public:
     rasterizer.polygonMode = VK_POLYGON_MODE_FILL; // how fragments are generated for geometry
     rasterizer.lineWidth = 1.0f; // thickness of lines in terms of number of fragments
 
-    rasterizer.cullMode = VK_CULL_MODE_BACK_BIT;
-    rasterizer.frontFace = VK_FRONT_FACE_CLOCKWISE;
+    rasterizer.cullMode = desc.cull_mode;
+    rasterizer.frontFace = desc.front_face;
 
     rasterizer.depthBiasEnable = VK_FALSE;
     rasterizer.depthBiasConstantFactor = 0.0f; // Optional
@@ -125,13 +134,15 @@ public:
     colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO; // Optional
     colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD; // Optional
 
-    //colorBlendAttachment.blendEnable = VK_TRUE;
-    //colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
-    //colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
-    //colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
-    //colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
-    //colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
-    //colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
+    if (desc.blend) {
+      colorBlendAttachment.blendEnable = VK_TRUE;
+      colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+      colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+      colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
+      colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+      colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+      colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
+    }
 
     VkPipelineColorBlendStateCreateInfo colorBlending{};
     colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
@@ -146,7 +157,7 @@ public:
 
     vector<VkDynamicState> dynamicStates = {
       VK_DYNAMIC_STATE_VIEWPORT,
-      VK_DYNAMIC_STATE_LINE_WIDTH
+      VK_DYNAMIC_STATE_SCISSOR
     };
 
     VkPipelineDynamicStateCreateInfo dynamicState{};
@@ -168,11 +179,11 @@ public:
     VkGraphicsPipelineCreateInfo pipelineInfo{};
     pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
 
-    Shader vert(device, "shaders/vert.spv");
-    Shader frag(device, "shaders/frag.spv");
+    Shader vert(device, desc.vert_shader);
+    Shader frag(device, desc.frag_shader);
     VkPipelineShaderStageCreateInfo stages[] = {
-      vert.pipeline_stage(VK_SHADER_STAGE_VERTEX_BIT), 
-      frag.pipeline_stage(VK_SHADER_STAGE_FRAGMENT_BIT) 
+      vert.pipeline_stage(VK_SHADER_STAGE_VERTEX_BIT, &desc.vert_constants), 
+      frag.pipeline_stage(VK_SHADER_STAGE_FRAGMENT_BIT, &desc.frag_constants) 
     };
     pipelineInfo.stageCount = 2;
     pipelineInfo.pStages = stages;
@@ -184,21 +195,31 @@ public:
     pipelineInfo.pMultisampleState = &multisampling;
     pipelineInfo.pDepthStencilState = nullptr; // Optional
     pipelineInfo.pColorBlendState = &colorBlending;
-    pipelineInfo.pDynamicState = nullptr; // Optional
+    pipelineInfo.pDynamicState = &dynamicState;
     pipelineInfo.layout = layout;
     pipelineInfo.renderPass = renderpass->get();
     pipelineInfo.subpass = 0;
     pipelineInfo.basePipelineHandle = VK_NULL_HANDLE; // Optional
     pipelineInfo.basePipelineIndex = -1; // Optional
 
-    if (vkCreateGraphicsPipelines(device->get(), VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS) {
+    VkPipelineCache cache = use_cache ? device->pipeline_cache->get() : VK_NULL_HANDLE;
+
+    auto start = chrono::steady_clock::now();
+    if (vkCreateGraphicsPipelines(device->get(), cache, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS) {
       throw runtime_error("failed to create graphics pipeline!");
     }
+    create_ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+    if (use_cache) {
+      device->pipeline_cache->record(create_ms);
+    }
   }
 
   ~GraphicsPipeline() {
     cout << "~GraphicsPipeline\n";
-    vkDestroyPipelineLayout(device->get(), layout, nullptr);
-    vkDestroyPipeline(device->get(), pipeline, nullptr);
+    device->deletion_queue->push([device = device->get(), layout = layout, pipeline = pipeline]() {
+      vkDestroyPipelineLayout(device, layout, nullptr);
+      vkDestroyPipeline(device, pipeline, nullptr);
+    });
   }
 };
@@ -0,0 +1,68 @@
+#pragma once
+
+#include "LogicalDevice.h"
+
+#include "vulkan_include.h"
+#include "utils.h"
+#include "vk_utils.h"
+
+using namespace std;
+using namespace utils;
+
+/***
+ * device-owned image, i.e. one that we allocate ourselves instead of getting it from the swapchain.
+ * used as an offscreen render target when running headless (no window / surface / swapchain)
+ */
+class Image {
+  ptr<LogicalDevice> device;
+  VkImage image;
+  MemoryAllocation memory;
+
+public:
+  VkFormat format;
+  VkExtent2D extent;
+
+  VkImage get() { return image; }
+
+  Image(
+    ptr<LogicalDevice> device,
+    VkFormat format,
+    VkExtent2D extent,
+    VkImageUsageFlags usage
+  ) : device(device)
+    , format(format)
+    , extent(extent)
+  {
+    VkImageCreateInfo create_info{};
+    create_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    create_info.imageType = VK_IMAGE_TYPE_2D;
+    create_info.format = format;
+    create_info.extent = { extent.width, extent.height, 1 };
+    create_info.mipLevels = 1;
+    create_info.arrayLayers = 1;
+    create_info.samples = VK_SAMPLE_COUNT_1_BIT;
+    create_info.tiling = VK_IMAGE_TILING_OPTIMAL; // implementation defined layout, best for rendering into
+    create_info.usage = usage;
+    create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    create_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+    if (vkCreateImage(device->get(), &create_info, nullptr, &image) != VK_SUCCESS) {
+      throw runtime_error("failed to create image");
+    }
+
+    VkMemoryRequirements memreqs;
+    vkGetImageMemoryRequirements(device->get(), image, &memreqs);
+
+    // optimal tiling == non-linear, see MemoryAllocator about bufferImageGranularity
+    memory = device->allocator->alloc(memreqs, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, false);
+    vkBindImageMemory(device->get(), image, memory.memory, memory.offset);
+  }
+
+  ~Image() {
+    auto allocator = device->allocator.get();
+    device->deletion_queue->push([device = device->get(), allocator, image = image, memory = memory]() {
+      vkDestroyImage(device, image, nullptr);
+      allocator->free(memory);
+    });
+  }
+};
@@ -2,6 +2,7 @@
 
 #include "LogicalDevice.h"
 #include "Swapchain.h"
+#include "Image.h"
 
 #include "vulkan_include.h"
 #include "utils.h"
@@ -13,17 +14,10 @@ using namespace utils;
 class ImageView {
   VkImageView view;
   ptr<LogicalDevice> device;
-  ptr<Swapchain> swapchain;
+  ptr<Swapchain> swapchain; // owner of the image, either this or owner_image is set
+  ptr<Image> owner_image;
 
-public:
-  ImageView(
-    ptr<LogicalDevice> device,
-    ptr<Swapchain> swapchain,
-    VkImage image,
-    VkFormat format
-  ) : device(device)
-    , swapchain(swapchain)
-  {
+  void init(VkImage image, VkFormat format) {
     VkImageViewCreateInfo create_info{};
     create_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
 
@@ -45,8 +39,29 @@ public:
     }
   }
 
+public:
+  ImageView(
+    ptr<LogicalDevice> device,
+    ptr<Swapchain> swapchain,
+    VkImage image,
+    VkFormat format
+  ) : device(device)
+    , swapchain(swapchain)
+  {
+    init(image, format);
+  }
+
+  ImageView(ptr<LogicalDevice> device, ptr<Image> image)
+    : device(device)
+    , owner_image(image)
+  {
+    init(image->get(), image->format);
+  }
+
   ~ImageView() {
-    vkDestroyImageView(device->get(), view, nullptr);
+    device->deletion_queue->push([device = device->get(), view = view]() {
+      vkDestroyImageView(device, view, nullptr);
+    });
   }
 
   VkImageView get() { return view; }
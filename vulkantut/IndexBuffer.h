@@ -0,0 +1,120 @@
+#pragma once
+
+#include "LogicalDevice.h"
+#include "Buffer.h"
+#include "Uploader.h"
+#include "VertexBuffer.h"
+#include "InstanceBuffer.h"
+
+#include "vulkan_include.h"
+#include "utils.h"
+#include "vk_utils.h"
+
+using namespace std;
+using namespace utils;
+
+/***
+ * what an indexed draw reads its indices from
+ */
+struct IndexSpan {
+  VkBuffer buffer = VK_NULL_HANDLE;
+  VkDeviceSize offset = 0;
+  u32 count = 0;
+  VkIndexType type = VK_INDEX_TYPE_UINT16;
+};
+
+class GpuCulling;
+class VertexAnimator;
+
+/***
+ * what a draw call reads. indices.count == 0 -> non-indexed draw, instances.count == 0 -> a single,
+ * non-instanced copy
+ */
+struct Geometry {
+  VertexSpan vertices;
+  IndexSpan indices{};
+  InstanceSpan instances{};
+
+  // num of draw calls it's drawn w/, > 1 only to benchmark draw call overhead. W/ instances they're
+  // split among the draws (e.g. 1 per draw, instead of all of them in one), w/o it's drawn again
+  u32 draws = 1;
+
+  // if set, the instances are culled & drawn by the GPU (indirectly), draws is ignored
+  GpuCulling* culling = nullptr;
+
+  // if set, vertices is its output, written by its compute pass right before the render pass
+  VertexAnimator* animator = nullptr;
+};
+
+
+class IndexBuffer {
+  ptr<LogicalDevice> device;
+  ptr<Buffer> buffer;
+  u32 count;
+  VkIndexType type;
+
+  // 16 bit indices whenever they fit, halves the index bandwidth. 0xFFFF is excluded since it's the
+  // primitive restart value
+  static vector<char> pack(const vector<u32>& indices, VkIndexType& type) {
+    u32 max_index = indices.empty() ? 0 : *max_element(indices.cbegin(), indices.cend());
+    type = max_index < 0xFFFF ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+
+    if (type == VK_INDEX_TYPE_UINT32) {
+      vector<char> res(indices.size() * sizeof(u32));
+      memcpy(res.data(), indices.data(), res.size());
+      return res;
+    }
+
+    vector<char> res(indices.size() * sizeof(uint16_t));
+    auto dst = reinterpret_cast<uint16_t*>(res.data());
+    for (size_t i = 0; i < indices.size(); ++i) {
+      dst[i] = static_cast<uint16_t>(indices[i]);
+    }
+    return res;
+  }
+
+public:
+  VkBuffer get() { return buffer->get(); }
+
+  u32 size() { return count; }
+
+  VkIndexType index_type() { return type; }
+
+  IndexSpan span() { return { buffer->get(), 0, count, type }; }
+
+  // HOST_VISIBLE, see VertexBuffer
+  IndexBuffer(ptr<LogicalDevice> device, const vector<u32>& indices)
+    : device(device)
+    , count(static_cast<u32>(indices.size()))
+  {
+    auto data = pack(indices, type);
+    buffer = mk_ptr<Buffer>(
+      device,
+      (std::max)(data.size(), sizeof(u32)), // a VkBuffer can't be empty, see VertexBuffer
+      VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
+    );
+
+    if (!data.empty()) {
+      memcpy(buffer->mapped(), data.data(), data.size());
+    }
+  }
+
+  // DEVICE_LOCAL, uploader->flush() before drawing w/ this buffer
+  IndexBuffer(ptr<LogicalDevice> device, ptr<Uploader> uploader, const vector<u32>& indices)
+    : device(device)
+    , count(static_cast<u32>(indices.size()))
+  {
+    auto data = pack(indices, type);
+    buffer = mk_ptr<Buffer>(
+      device,
+      (std::max)(data.size(), sizeof(u32)), // a VkBuffer can't be empty, see VertexBuffer
+      VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
+    );
+
+    if (!data.empty()) {
+      uploader->upload(buffer->get(), data.data(), data.size());
+    }
+  }
+};
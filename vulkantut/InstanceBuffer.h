@@ -0,0 +1,55 @@
+#pragma once
+
+#include "LogicalDevice.h"
+#include "Vertex.h"
+#include "Buffer.h"
+#include "Uploader.h"
+
+#include "vulkan_include.h"
+#include "utils.h"
+#include "vk_utils.h"
+
+using namespace std;
+using namespace utils;
+
+/***
+ * what an instanced draw reads its per-instance data from (binding 1)
+ */
+struct InstanceSpan {
+  VkBuffer buffer = VK_NULL_HANDLE;
+  VkDeviceSize offset = 0;
+  u32 count = 0;
+};
+
+
+// I is the per-instance struct (e.g. Instance), the pipeline drawing it must be built w/
+// VertexLayout::instanced<I>()
+class InstanceBuffer {
+  ptr<LogicalDevice> device;
+  ptr<Buffer> buffer;
+  u32 count;
+
+public:
+  VkBuffer get() { return buffer->get(); }
+
+  u32 size() { return count; }
+
+  InstanceSpan span() { return { buffer->get(), 0, count }; }
+
+  // DEVICE_LOCAL, uploader->flush() before drawing w/ this buffer
+  template<typename I>
+  InstanceBuffer(ptr<LogicalDevice> device, ptr<Uploader> uploader, const vector<I>& instances)
+    : device(device)
+    , count(static_cast<u32>(instances.size()))
+  {
+    buffer = mk_ptr<Buffer>(
+      device,
+      sizeof(I) * instances.size(),
+      // storage: read by GpuCulling
+      VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
+    );
+
+    uploader->upload(buffer->get(), instances.data(), buffer->size);
+  }
+};
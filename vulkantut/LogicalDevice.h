@@ -2,6 +2,11 @@
 
 #include "PhysDevice.h"
 #include "QueueFamily.h"
+#include "MemoryAllocator.h"
+#include "PipelineCache.h"
+#include "ShaderLibrary.h"
+#include "DeletionQueue.h"
+#include "TimelineSemaphore.h"
 
 #include "vulkan_include.h"
 #include "utils.h"
@@ -20,19 +25,72 @@ public:
   VkQueue graphics_q;
   VkQueue present_q;
 
+  // a queue of a dedicated family if the device has one, so copies / compute overlap w/ graphics.
+  // Otherwise an alias of graphics_q. Resources crossing families need ownership transfers, see
+  // vk_ownership_barrier()
+  VkQueue transfer_q;
+  VkQueue compute_q;
+
+  u32 graphics_qfam;
+  u32 present_qfam;
+  u32 transfer_qfam;
+  u32 compute_qfam;
+
+  // all device memory should go through this instead of vkAllocateMemory
+  uptr<MemoryAllocator> allocator;
+
+  // every pipeline should be created w/ this, it's loaded from / saved to disk
+  uptr<PipelineCache> pipeline_cache;
+
+  // shader modules are loaded through this, once per device
+  uptr<ShaderLibrary> shaders;
+
+  // wrappers of objects the GPU might still be using destroy them through this, see DeletionQueue
+  uptr<DeletionQueue> deletion_queue;
+
+  // signaled w/ the DeletionQueue serial of every frame submitted to graphics_q, so frame N is done
+  // once its value is >= N. Null if the device has no timeline semaphores, frames use fences then
+  uptr<TimelineSemaphore> graphics_timeline;
+
+  // VK_KHR_present_wait (and present_id) were enabled, see wait_for_present()
+  bool present_wait = false;
+  PFN_vkWaitForPresentKHR vk_wait_for_present = nullptr; // not exported by the loader
+
   VkDevice get() { return device; }
 
   ~LogicalDevice() {
+    wait_idle(); // destroys whatever is still queued, it might need the allocator
+    deletion_queue = nullptr;
+    graphics_timeline = nullptr;
+    allocator = nullptr; // frees the memory blocks, must happen before the device is gone
+    pipeline_cache = nullptr; // saves it to disk
+    shaders = nullptr;
     vkDestroyDevice(device, nullptr);
   }
 
   LogicalDevice(
     ptr<PhysDevice> physical_device, 
     const QueueFamily& graphics_queue_family,
-    const QueueFamily& present_queue_family
+    const QueueFamily& present_queue_family,
+    const vector<const char*>& device_extensions = { VK_KHR_SWAPCHAIN_EXTENSION_NAME },
+    const string& pipeline_cache_path = "pipeline_cache.bin"
   ) 
     : physical_device(physical_device) 
+    , graphics_qfam(graphics_queue_family.index)
+    , present_qfam(present_queue_family.index)
+    , transfer_qfam(graphics_queue_family.index)
+    , compute_qfam(graphics_queue_family.index)
   {
+    vector<QueueFamily> transfer_families = physical_device->transfer_queue_families();
+    if (!transfer_families.empty()) {
+      transfer_qfam = transfer_families.front().index;
+    }
+
+    vector<QueueFamily> compute_families = physical_device->compute_queue_families();
+    if (!compute_families.empty()) {
+      compute_qfam = compute_families.front().index;
+    }
+
     VkDeviceCreateInfo create_info{};
     create_info.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
 
@@ -41,7 +99,7 @@ public:
     // the type of input collection. 
     // but... internally map() also uses push_back which isn't available for set()... 
     vector<VkDeviceQueueCreateInfo> queue_create_infos = map(
-      to_vector(set<u32> { graphics_queue_family.index, present_queue_family.index }),
+      to_vector(set<u32> { graphics_qfam, present_qfam, transfer_qfam, compute_qfam }),
       // note that the priority is passed as pointer, so we have to get the reference to the local variable
       // otherwise we'll be passing a pointer to a lambda-local var 
       [&default_q_priority](u32 qfam_index) { return vk_queue_create_info(qfam_index, &default_q_priority); }
@@ -53,10 +111,35 @@ public:
     VkPhysicalDeviceFeatures features{};
     create_info.pEnabledFeatures = &features;
 
-    // TODO hardcoded 
-    vector<const char*> device_extensions = {
-      VK_KHR_SWAPCHAIN_EXTENSION_NAME,
-    };
+    // present wait's features must be enabled on top of its extensions
+    present_wait = find(
+      device_extensions,
+      [](const char* ext) { return strcmp(ext, VK_KHR_PRESENT_WAIT_EXTENSION_NAME) == 0; }
+    ).has_value();
+
+    VkPhysicalDevicePresentIdFeaturesKHR present_id_features{};
+    present_id_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR;
+    present_id_features.presentId = VK_TRUE;
+
+    VkPhysicalDevicePresentWaitFeaturesKHR present_wait_features{};
+    present_wait_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR;
+    present_wait_features.pNext = &present_id_features;
+    present_wait_features.presentWait = VK_TRUE;
+
+    // always on when there, see graphics_timeline
+    bool timeline = physical_device->supports_timeline_semaphore();
+
+    VkPhysicalDeviceTimelineSemaphoreFeatures timeline_features{};
+    timeline_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES;
+    timeline_features.timelineSemaphore = VK_TRUE;
+
+    void* features_chain = present_wait ? &present_wait_features : nullptr;
+    if (timeline) {
+      timeline_features.pNext = features_chain;
+      features_chain = &timeline_features;
+    }
+    create_info.pNext = features_chain;
+
     create_info.enabledExtensionCount = static_cast<u32>(device_extensions.size());
     create_info.ppEnabledExtensionNames = device_extensions.data();
 
@@ -71,8 +154,34 @@ public:
       throw runtime_error("failed to create logical device");
     }
 
-    vkGetDeviceQueue(device, graphics_queue_family.index, 0, &graphics_q);
-    vkGetDeviceQueue(device, present_queue_family.index, 0, &present_q);
+    vkGetDeviceQueue(device, graphics_qfam, 0, &graphics_q);
+    vkGetDeviceQueue(device, present_qfam, 0, &present_q);
+    vkGetDeviceQueue(device, transfer_qfam, 0, &transfer_q);
+    vkGetDeviceQueue(device, compute_qfam, 0, &compute_q);
+
+    cout << format(
+      "queue families: graphics {}, present {}, transfer {}{}, compute {}{}\n",
+      graphics_qfam,
+      present_qfam,
+      transfer_qfam,
+      transfer_qfam != graphics_qfam ? " (dedicated)" : "",
+      compute_qfam,
+      compute_qfam != graphics_qfam ? " (dedicated)" : ""
+    );
+
+    if (present_wait) {
+      vk_wait_for_present = reinterpret_cast<PFN_vkWaitForPresentKHR>(
+        vkGetDeviceProcAddr(device, "vkWaitForPresentKHR")
+      );
+    }
+
+    deletion_queue = mk_uptr<DeletionQueue>();
+    if (timeline) {
+      graphics_timeline = mk_uptr<TimelineSemaphore>(device);
+    }
+    allocator = mk_uptr<MemoryAllocator>(device, physical_device);
+    pipeline_cache = mk_uptr<PipelineCache>(device, physical_device, pipeline_cache_path);
+    shaders = mk_uptr<ShaderLibrary>(device);
   }
 
   void wait_fences(vector<VkFence>& fences) {
@@ -83,20 +192,26 @@ public:
     vkResetFences(device, fences.size(), fences.data());
   }
 
+  // single fence versions of the above, nothing to allocate, for the per-frame path
+  void wait_fence(VkFence fence) {
+    vkWaitForFences(device, 1, &fence, VK_TRUE, UINT64_MAX);
+  }
+
+  void reset_fence(VkFence fence) {
+    vkResetFences(device, 1, &fence);
+  }
+
+  // blocks until present_id (or a later one) of swapchain is displayed, or timeout_ns passed
+  VkResult wait_for_present(VkSwapchainKHR swapchain, uint64_t present_id, uint64_t timeout_ns) {
+    return vk_wait_for_present(device, swapchain, present_id, timeout_ns);
+  }
+
   void wait_idle() {
     vkDeviceWaitIdle(device);
+    deletion_queue->retire_all();
   }
 
   u32 find_mem_type(u32 type_filter, VkMemoryPropertyFlags props) {
-    VkPhysicalDeviceMemoryProperties memprops;
-    vkGetPhysicalDeviceMemoryProperties(physical_device->get(), &memprops);
-
-    for (u32 i = 0; i < memprops.memoryTypeCount; ++i) {
-      if ((type_filter & (1 << i)) && (memprops.memoryTypes[i].propertyFlags & props) == props) {
-        return i;
-      }
-    }
-
-    throw runtime_error("failed to find suitable memory type");
+    return allocator->find_mem_type(type_filter, props);
   }
 };
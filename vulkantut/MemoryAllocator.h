@@ -0,0 +1,300 @@
+#pragma once
+
+#include "PhysDevice.h"
+
+#include "vulkan_include.h"
+#include "utils.h"
+
+using namespace std;
+using namespace utils;
+
+class MemoryBlock;
+
+/***
+ * sub-range of a MemoryBlock. Bind w/ vkBind*Memory(device, resource, memory, offset).
+ * mapped is non-null for host visible memory (whole blocks are persistently mapped)
+ */
+struct MemoryAllocation {
+  VkDeviceMemory memory = VK_NULL_HANDLE;
+  VkDeviceSize offset = 0;
+  VkDeviceSize size = 0;
+  void* mapped = nullptr;
+  MemoryBlock* block = nullptr;
+};
+
+/***
+ * one vkAllocateMemory'd chunk of a single memory type, handed out in pieces.
+ * free ranges are kept sorted by offset so that neighbours can be merged on free. A sorted vector
+ * rather than a std::map: there are few free ranges per block, and <map> clashes w/ utils::map
+ */
+class MemoryBlock {
+  struct FreeRange {
+    VkDeviceSize offset;
+    VkDeviceSize size;
+  };
+
+  VkDevice device;
+  vector<FreeRange> free_ranges;
+
+public:
+  VkDeviceMemory memory;
+  const u32 mem_type;
+  const VkDeviceSize size;
+  VkDeviceSize used = 0;
+  u32 allocations = 0;
+  void* mapped = nullptr;
+
+  MemoryBlock(VkDevice device, u32 mem_type, VkDeviceSize size, bool host_visible)
+    : device(device)
+    , mem_type(mem_type)
+    , size(size)
+  {
+    VkMemoryAllocateInfo meminfo{};
+    meminfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    meminfo.allocationSize = size;
+    meminfo.memoryTypeIndex = mem_type;
+
+    if (vkAllocateMemory(device, &meminfo, nullptr, &memory) != VK_SUCCESS) {
+      throw runtime_error("failed to allocate device memory block");
+    }
+
+    // a VkDeviceMemory can only be mapped once at a time, so map the whole block once and
+    // have all sub-allocations point into it
+    if (host_visible) {
+      vkMapMemory(device, memory, 0, VK_WHOLE_SIZE, 0, &mapped);
+    }
+
+    free_ranges.push_back({ 0, size });
+  }
+
+  ~MemoryBlock() {
+    if (mapped) {
+      vkUnmapMemory(device, memory);
+    }
+    vkFreeMemory(device, memory, nullptr);
+  }
+
+  // first fit. align is a power of two (as all vulkan alignments are)
+  optional<VkDeviceSize> alloc(VkDeviceSize alloc_size, VkDeviceSize align) {
+    for (auto it = free_ranges.begin(); it != free_ranges.end(); ++it) {
+      VkDeviceSize range_begin = it->offset;
+      VkDeviceSize range_end = it->offset + it->size;
+      VkDeviceSize offset = (range_begin + align - 1) & ~(align - 1);
+
+      if (offset + alloc_size > range_end) {
+        continue;
+      }
+
+      // the range is split into (up to) two: the alignment padding before, the leftover after
+      it = free_ranges.erase(it);
+      if (offset + alloc_size < range_end) {
+        it = free_ranges.insert(it, { offset + alloc_size, range_end - (offset + alloc_size) });
+      }
+      if (offset > range_begin) {
+        free_ranges.insert(it, { range_begin, offset - range_begin });
+      }
+
+      used += alloc_size;
+      allocations += 1;
+      return offset;
+    }
+
+    return {};
+  }
+
+  void free(VkDeviceSize offset, VkDeviceSize alloc_size) {
+    used -= alloc_size;
+    allocations -= 1;
+
+    auto it = lower_bound(
+      free_ranges.begin(),
+      free_ranges.end(),
+      offset,
+      [](const FreeRange& range, VkDeviceSize offset) { return range.offset < offset; }
+    );
+    it = free_ranges.insert(it, { offset, alloc_size });
+
+    // merge w/ the following range
+    auto next = it + 1;
+    if (next != free_ranges.end() && it->offset + it->size == next->offset) {
+      it->size += next->size;
+      free_ranges.erase(next);
+    }
+
+    // merge w/ the preceding range
+    if (it != free_ranges.begin()) {
+      auto prev = it - 1;
+      if (prev->offset + prev->size == it->offset) {
+        prev->size += it->size;
+        free_ranges.erase(it);
+      }
+    }
+  }
+
+  VkDeviceSize largest_free_range() const {
+    VkDeviceSize res = 0;
+    for (auto& range : free_ranges) {
+      res = (std::max)(res, range.size);
+    }
+    return res;
+  }
+};
+
+/***
+ * Allocates large blocks per memory type and sub-allocates from them, instead of a vkAllocateMemory
+ * per resource. Drivers limit the number of allocations (maxMemoryAllocationCount, can be as low as
+ * 4096) and each allocation is a round-trip to the kernel.
+ *
+ * bufferImageGranularity: linear (buffers) and non-linear (optimal tiling images) resources can't
+ * share a "page" of that size in the same VkDeviceMemory. Non-linear allocations have both their
+ * offset and size rounded up to the granularity, so they always own whole pages and any neighbour,
+ * whatever its kind, is on a different page.
+ */
+class MemoryAllocator {
+  VkDevice device;
+  VkPhysicalDeviceMemoryProperties memprops;
+  VkDeviceSize granularity;
+  u32 max_allocations;
+
+  vector<vector<uptr<MemoryBlock>>> blocks; // per memory type
+
+  static VkDeviceSize align_up(VkDeviceSize value, VkDeviceSize align) {
+    return (value + align - 1) & ~(align - 1);
+  }
+
+  u32 blocks_count() const {
+    u32 res = 0;
+    for (auto& type_blocks : blocks) {
+      res += static_cast<u32>(type_blocks.size());
+    }
+    return res;
+  }
+
+  // smaller heaps (e.g. the 256MB BAR heap) get smaller blocks so one block doesn't hog the heap
+  VkDeviceSize preferred_block_size(u32 mem_type) const {
+    VkDeviceSize heap_size = memprops.memoryHeaps[memprops.memoryTypes[mem_type].heapIndex].size;
+    return (std::min)(default_block_size, heap_size / 8);
+  }
+
+public:
+  static constexpr VkDeviceSize default_block_size = 64 * 1024 * 1024;
+
+  struct Stats {
+    u32 blocks = 0;
+    u32 allocations = 0;
+    VkDeviceSize bytes_reserved = 0; // sum of block sizes
+    VkDeviceSize bytes_used = 0;
+
+    // 1 - largest free range / total free, per block, averaged. 0 when all free space is contiguous
+    double fragmentation = 0.0;
+
+    string to_str() const {
+      return format(
+        "memory: {} blocks, {} allocations, {:.2f}/{:.2f} MB used, fragmentation {:.2f}",
+        blocks,
+        allocations,
+        bytes_used / (1024.0 * 1024.0),
+        bytes_reserved / (1024.0 * 1024.0),
+        fragmentation
+      );
+    }
+  };
+
+  MemoryAllocator(VkDevice device, ptr<PhysDevice> physical_device) : device(device) {
+    vkGetPhysicalDeviceMemoryProperties(physical_device->get(), &memprops);
+
+    auto limits = physical_device->properties().limits;
+    granularity = limits.bufferImageGranularity;
+    max_allocations = limits.maxMemoryAllocationCount;
+
+    blocks.resize(memprops.memoryTypeCount);
+  }
+
+  u32 find_mem_type(u32 type_filter, VkMemoryPropertyFlags props) const {
+    for (u32 i = 0; i < memprops.memoryTypeCount; ++i) {
+      if ((type_filter & (1 << i)) && (memprops.memoryTypes[i].propertyFlags & props) == props) {
+        return i;
+      }
+    }
+
+    throw runtime_error("failed to find suitable memory type");
+  }
+
+  // linear == buffers and linear tiling images, !linear == optimal tiling images
+  MemoryAllocation alloc(const VkMemoryRequirements& reqs, VkMemoryPropertyFlags props, bool linear) {
+    u32 mem_type = find_mem_type(reqs.memoryTypeBits, props);
+
+    VkDeviceSize align = reqs.alignment;
+    VkDeviceSize size = reqs.size;
+    if (!linear) {
+      align = (std::max)(align, granularity);
+      size = align_up(size, granularity);
+    }
+
+    auto res = [&](MemoryBlock* block, VkDeviceSize offset) {
+      MemoryAllocation allocation;
+      allocation.memory = block->memory;
+      allocation.offset = offset;
+      allocation.size = size;
+      allocation.mapped = block->mapped ? static_cast<char*>(block->mapped) + offset : nullptr;
+      allocation.block = block;
+      return allocation;
+    };
+
+    for (auto& block : blocks[mem_type]) {
+      if (auto offset = block->alloc(size, align)) {
+        return res(block.get(), *offset);
+      }
+    }
+
+    if (blocks_count() >= max_allocations) {
+      throw runtime_error(format("out of device memory allocations (maxMemoryAllocationCount {})", max_allocations));
+    }
+
+    // resources larger than a block get a block of their own
+    bool host_visible = memprops.memoryTypes[mem_type].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+    VkDeviceSize block_size = (std::max)(preferred_block_size(mem_type), size);
+    blocks[mem_type].push_back(mk_uptr<MemoryBlock>(device, mem_type, block_size, host_visible));
+
+    MemoryBlock* block = blocks[mem_type].back().get();
+    return res(block, *block->alloc(size, align));
+  }
+
+  void free(const MemoryAllocation& allocation) {
+    MemoryBlock* block = allocation.block;
+    block->free(allocation.offset, allocation.size);
+
+    // keep one block per type around even when empty, to avoid alloc / free churn
+    auto& type_blocks = blocks[block->mem_type];
+    if (block->allocations == 0 && type_blocks.size() > 1) {
+      type_blocks.erase(std::find_if(
+        type_blocks.begin(),
+        type_blocks.end(),
+        [block](const uptr<MemoryBlock>& b) { return b.get() == block; }
+      ));
+    }
+  }
+
+  Stats stats() const {
+    Stats res;
+    for (auto& type_blocks : blocks) {
+      for (auto& block : type_blocks) {
+        res.blocks += 1;
+        res.allocations += block->allocations;
+        res.bytes_reserved += block->size;
+        res.bytes_used += block->used;
+
+        VkDeviceSize free_bytes = block->size - block->used;
+        if (free_bytes > 0) {
+          res.fragmentation += 1.0 - static_cast<double>(block->largest_free_range()) / free_bytes;
+        }
+      }
+    }
+
+    if (res.blocks > 0) {
+      res.fragmentation /= res.blocks;
+    }
+
+    return res;
+  }
+};
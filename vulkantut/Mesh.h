@@ -0,0 +1,198 @@
+#pragma once
+
+#include <unordered_map>
+#include <deque>
+
+#include "Vertex.h"
+
+#include "utils.h"
+
+using namespace std;
+using namespace utils;
+
+/***
+ * Tipsify (Sander, Nehab & Barczak, "Fast Triangle Reordering for Vertex Locality and Reduced
+ * Overdraw", 2007). Linear time, picks a "fanning" vertex and emits all of its remaining triangles,
+ * then moves on to the 1-ring neighbour that is most likely still in a cache of cache_size entries.
+ */
+vector<u32> optimize_vertex_cache(const vector<u32>& indices, u32 vertex_count, u32 cache_size = 16) {
+  u32 triangle_count = static_cast<u32>(indices.size() / 3);
+
+  // vertex -> triangles using it, as offsets into one flat array
+  vector<u32> live(vertex_count, 0); // num of not yet emitted triangles per vertex
+  for (u32 i : indices) {
+    ++live[i];
+  }
+
+  vector<u32> adjacency_offsets(vertex_count + 1, 0);
+  for (u32 v = 0; v < vertex_count; ++v) {
+    adjacency_offsets[v + 1] = adjacency_offsets[v] + live[v];
+  }
+
+  vector<u32> adjacency(indices.size());
+  vector<u32> fill(adjacency_offsets.begin(), adjacency_offsets.end() - 1);
+  for (u32 t = 0; t < triangle_count; ++t) {
+    for (u32 k = 0; k < 3; ++k) {
+      adjacency[fill[indices[t * 3 + k]]++] = t;
+    }
+  }
+
+  vector<u32> cache_time(vertex_count, 0);
+  vector<bool> emitted(triangle_count, false);
+  vector<u32> dead_end;
+  vector<u32> candidates;
+  vector<u32> res;
+  res.reserve(indices.size());
+
+  u32 time = cache_size + 1;
+  u32 cursor = 1;
+  int64_t fanning = vertex_count > 0 ? 0 : -1;
+
+  auto skip_dead_end = [&]() -> int64_t {
+    while (!dead_end.empty()) {
+      u32 d = dead_end.back();
+      dead_end.pop_back();
+      if (live[d] > 0) {
+        return d;
+      }
+    }
+
+    while (cursor < vertex_count) {
+      if (live[cursor] > 0) {
+        return cursor;
+      }
+      ++cursor;
+    }
+
+    return -1;
+  };
+
+  while (fanning >= 0) {
+    candidates.clear();
+
+    u32 f = static_cast<u32>(fanning);
+    for (u32 a = adjacency_offsets[f]; a < adjacency_offsets[f + 1]; ++a) {
+      u32 t = adjacency[a];
+      if (emitted[t]) {
+        continue;
+      }
+
+      for (u32 k = 0; k < 3; ++k) {
+        u32 v = indices[t * 3 + k];
+        res.push_back(v);
+        dead_end.push_back(v);
+        candidates.push_back(v);
+        --live[v];
+
+        if (time - cache_time[v] > cache_size) {
+          cache_time[v] = time++;
+        }
+      }
+
+      emitted[t] = true;
+    }
+
+    // best candidate == one that'll still be in the cache after emitting all its triangles
+    int64_t next = -1;
+    int64_t best = -1;
+    for (u32 v : candidates) {
+      if (live[v] == 0) {
+        continue;
+      }
+
+      int64_t priority = 0;
+      if (time - cache_time[v] + 2 * live[v] <= cache_size) {
+        priority = time - cache_time[v];
+      }
+
+      if (priority > best) {
+        best = priority;
+        next = v;
+      }
+    }
+
+    fanning = next >= 0 ? next : skip_dead_end();
+  }
+
+  return res;
+}
+
+/***
+ * num of vertex shader invocations for drawing indices w/ a FIFO post-transform cache of
+ * cache_size entries (roughly what GPUs do). Non-indexed draws shade every vertex: indices.size()
+ */
+u32 shaded_vertices(const vector<u32>& indices, u32 cache_size = 16) {
+  deque<u32> cache;
+  u32 misses = 0;
+
+  for (u32 i : indices) {
+    if (std::find(cache.begin(), cache.end(), i) != cache.end()) {
+      continue;
+    }
+
+    ++misses;
+    cache.push_back(i);
+    if (cache.size() > cache_size) {
+      cache.pop_front();
+    }
+  }
+
+  return misses;
+}
+
+/***
+ * indexed mesh built on the CPU from a raw triangle list (3 vertices per triangle, shared
+ * vertices repeated), ready to go into a VertexBuffer + IndexBuffer.
+ *
+ * - identical vertices are merged, so each one is stored (and can be shaded) once
+ * - the triangles are reordered for the post-transform vertex cache (Tipsify, see
+ *   optimize_vertex_cache), so a shared vertex is likely still in the cache when it's used again
+ */
+template<typename V>
+struct MeshT {
+  vector<V> vertices;
+  vector<u32> indices;
+
+  // byte-wise, vertex types are plain structs w/o padding
+  struct VertexHash {
+    size_t operator()(const V& v) const {
+      // FNV-1a
+      auto bytes = reinterpret_cast<const unsigned char*>(&v);
+      size_t h = 14695981039346656037ull;
+      for (size_t i = 0; i < sizeof(V); ++i) {
+        h = (h ^ bytes[i]) * 1099511628211ull;
+      }
+      return h;
+    }
+  };
+
+  struct VertexEq {
+    bool operator()(const V& a, const V& b) const {
+      return memcmp(&a, &b, sizeof(V)) == 0;
+    }
+  };
+
+  static MeshT build(const vector<V>& triangles, bool optimize = true) {
+    MeshT res;
+    res.indices.reserve(triangles.size());
+
+    unordered_map<V, u32, VertexHash, VertexEq> unique;
+    unique.reserve(triangles.size());
+
+    for (auto& v : triangles) {
+      auto [it, inserted] = unique.try_emplace(v, static_cast<u32>(res.vertices.size()));
+      if (inserted) {
+        res.vertices.push_back(v);
+      }
+      res.indices.push_back(it->second);
+    }
+
+    if (optimize) {
+      res.indices = optimize_vertex_cache(res.indices, static_cast<u32>(res.vertices.size()));
+    }
+
+    return res;
+  }
+};
+
+using Mesh = MeshT<Vertex>;
@@ -40,6 +40,49 @@ public:
     return false;
   }
 
+  // VK_KHR_present_id + VK_KHR_present_wait, i.e. the CPU can wait for a given present to be
+  // displayed. Having the extensions isn't enough, the features must be there too. Those are
+  // queried w/ vkGetPhysicalDeviceFeatures2, which is only core on 1.1+ devices
+  bool supports_present_wait() const {
+    if (properties().apiVersion < VK_API_VERSION_1_1 ||
+        !supports_extension(VK_KHR_PRESENT_ID_EXTENSION_NAME) ||
+        !supports_extension(VK_KHR_PRESENT_WAIT_EXTENSION_NAME)
+    ) {
+      return false;
+    }
+
+    VkPhysicalDevicePresentIdFeaturesKHR present_id{};
+    present_id.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR;
+
+    VkPhysicalDevicePresentWaitFeaturesKHR present_wait{};
+    present_wait.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR;
+    present_wait.pNext = &present_id;
+
+    VkPhysicalDeviceFeatures2 features{};
+    features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    features.pNext = &present_wait;
+    vkGetPhysicalDeviceFeatures2(device, &features);
+
+    return present_id.presentId && present_wait.presentWait;
+  }
+
+  // core in Vulkan 1.2, but still a feature the device may not have
+  bool supports_timeline_semaphore() const {
+    if (properties().apiVersion < VK_API_VERSION_1_2) {
+      return false;
+    }
+
+    VkPhysicalDeviceTimelineSemaphoreFeatures timeline{};
+    timeline.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES;
+
+    VkPhysicalDeviceFeatures2 features{};
+    features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    features.pNext = &timeline;
+    vkGetPhysicalDeviceFeatures2(device, &features);
+
+    return timeline.timelineSemaphore;
+  }
+
   VkPhysicalDeviceProperties properties() const {
     VkPhysicalDeviceProperties p;
     vkGetPhysicalDeviceProperties(device, &p);
@@ -70,6 +113,23 @@ public:
     );
   }
 
+  // transfer-only families, usually the copy engines of discrete GPUs. Copies submitted there run
+  // alongside graphics instead of taking its queue's time
+  vector<QueueFamily> transfer_queue_families() const {
+    return filter(
+      queue_families(),
+      [](const QueueFamily& qfam) { return qfam.supports_transfer() && !qfam.supports_graphics() && !qfam.supports_compute(); }
+    );
+  }
+
+  // compute w/o graphics, for async compute next to the graphics queue
+  vector<QueueFamily> compute_queue_families() const {
+    return filter(
+      queue_families(),
+      [](const QueueFamily& qfam) { return qfam.supports_compute() && !qfam.supports_graphics(); }
+    );
+  }
+
   vector<QueueFamily> present_queue_families(VkSurfaceKHR surface) const {
     return filter(
       queue_families(),
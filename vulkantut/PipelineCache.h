@@ -0,0 +1,177 @@
+#pragma once
+
+#include <filesystem>
+#include <mutex>
+
+#include "PhysDevice.h"
+
+#include "vulkan_include.h"
+#include "utils.h"
+
+using namespace std;
+using namespace utils;
+
+/***
+ * VkPipelineCache persisted to disk between runs, so pipelines are only compiled from SPIR-V on
+ * the very first run (or after a driver update).
+ *
+ * file layout: our Header (magic, driver version, size of the blob), followed by the blob from
+ * vkGetPipelineCacheData, which starts w/ VkPipelineCacheHeaderVersionOne (vendor, device and
+ * pipelineCacheUUID). If any of these don't match the current device the file is ignored, the
+ * driver would either reject it or, worse, trust it.
+ */
+class PipelineCache {
+  struct Header {
+    uint32_t magic;
+    uint32_t driver_version;
+    uint64_t data_size;
+  };
+
+  static constexpr uint32_t magic = 0x43504B56; // "VKPC"
+
+  VkDevice device;
+  ptr<PhysDevice> physical_device;
+  string path;
+  VkPipelineCache cache;
+  mutable mutex stats_mutex; // record() is called from PipelineCompiler's workers
+
+  // returns the blob, empty if there's no file or it's stale / corrupt
+  vector<char> load() {
+    ifstream file(path, ios::binary | ios::ate);
+    if (!file.is_open()) {
+      cout << format("pipeline cache: no {}, cold start\n", path);
+      return {};
+    }
+
+    size_t file_size = file.tellg();
+    file.seekg(0);
+
+    Header header{};
+    if (file_size < sizeof(Header) || !file.read(reinterpret_cast<char*>(&header), sizeof(Header))) {
+      cout << format("pipeline cache: {} is truncated, discarding\n", path);
+      return {};
+    }
+
+    auto props = physical_device->properties();
+    if (header.magic != magic || header.data_size != file_size - sizeof(Header)) {
+      cout << format("pipeline cache: {} is corrupt, discarding\n", path);
+      return {};
+    }
+
+    if (header.driver_version != props.driverVersion) {
+      cout << format("pipeline cache: {} is from another driver version, discarding\n", path);
+      return {};
+    }
+
+    vector<char> data(header.data_size);
+    file.read(data.data(), data.size());
+
+    VkPipelineCacheHeaderVersionOne vk_header{};
+    if (data.size() < sizeof(vk_header)) {
+      return {};
+    }
+    memcpy(&vk_header, data.data(), sizeof(vk_header));
+
+    if (vk_header.headerVersion != VK_PIPELINE_CACHE_HEADER_VERSION_ONE ||
+        vk_header.vendorID != props.vendorID ||
+        vk_header.deviceID != props.deviceID ||
+        memcmp(vk_header.pipelineCacheUUID, props.pipelineCacheUUID, VK_UUID_SIZE) != 0
+    ) {
+      cout << format("pipeline cache: {} is from another device, discarding\n", path);
+      return {};
+    }
+
+    return data;
+  }
+
+public:
+  u32 pipelines_created = 0;
+  double create_ms = 0.0; // total time spent in vkCreate*Pipelines w/ this cache
+  size_t loaded_bytes = 0;
+
+  VkPipelineCache get() { return cache; }
+
+  PipelineCache(VkDevice device, ptr<PhysDevice> physical_device, const string& path)
+    : device(device)
+    , physical_device(physical_device)
+    , path(path)
+  {
+    auto data = load();
+    loaded_bytes = data.size();
+
+    VkPipelineCacheCreateInfo create_info{};
+    create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    create_info.initialDataSize = data.size();
+    create_info.pInitialData = data.empty() ? nullptr : data.data();
+
+    if (vkCreatePipelineCache(device, &create_info, nullptr, &cache) != VK_SUCCESS) {
+      throw runtime_error("failed to create pipeline cache");
+    }
+
+    if (!data.empty()) {
+      cout << format("pipeline cache: loaded {} bytes from {}\n", data.size(), path);
+    }
+  }
+
+  ~PipelineCache() {
+    try {
+      save();
+    } catch (const exception& ex) {
+      cerr << format("pipeline cache: failed to save: {}\n", ex.what());
+    }
+
+    vkDestroyPipelineCache(device, cache, nullptr);
+  }
+
+  // VkPipelineCache itself is internally synchronized, so one cache is shared by all threads creating
+  // pipelines. Only the stats need a lock
+  void record(double ms) {
+    lock_guard lock(stats_mutex);
+    pipelines_created += 1;
+    create_ms += ms;
+  }
+
+  // written to a temp file first and then renamed over the old one, so a crash mid-write never
+  // leaves a half written cache behind
+  void save() {
+    size_t size = 0;
+    vkGetPipelineCacheData(device, cache, &size, nullptr);
+
+    vector<char> data(size);
+    if (vkGetPipelineCacheData(device, cache, &size, data.data()) != VK_SUCCESS) {
+      throw runtime_error("failed to get pipeline cache data");
+    }
+
+    Header header{};
+    header.magic = magic;
+    header.driver_version = physical_device->properties().driverVersion;
+    header.data_size = size;
+
+    string tmp_path = path + ".tmp";
+    {
+      ofstream file(tmp_path, ios::binary | ios::trunc);
+      if (!file.is_open()) {
+        throw runtime_error(format("failed to open {}", tmp_path));
+      }
+
+      file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+      file.write(data.data(), size);
+      if (!file) {
+        throw runtime_error(format("failed to write {}", tmp_path));
+      }
+    }
+
+    filesystem::rename(tmp_path, path);
+    cout << format("pipeline cache: saved {} bytes to {}\n", size, path);
+  }
+
+  string to_str() const {
+    lock_guard lock(stats_mutex);
+    return format(
+      "pipeline cache: {} bytes loaded, {} pipelines created in {:.2f} ms",
+      loaded_bytes,
+      pipelines_created,
+      create_ms
+    );
+  }
+};
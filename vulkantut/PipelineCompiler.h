@@ -0,0 +1,139 @@
+#pragma once
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <future>
+#include <atomic>
+#include <deque>
+
+#include "LogicalDevice.h"
+#include "GraphicsPipeline.h"
+
+#include "vulkan_include.h"
+#include "utils.h"
+#include "vk_utils.h"
+
+using namespace std;
+using namespace utils;
+
+/***
+ * a pipeline that is (or was) being compiled by a PipelineCompiler. Cheap to copy, only get() blocks
+ */
+class PipelineHandle {
+  shared_future<ptr<GraphicsPipeline>> future;
+
+public:
+  PipelineHandle() = default;
+  PipelineHandle(shared_future<ptr<GraphicsPipeline>> future) : future(std::move(future)) {}
+
+  // false for a default constructed handle, i.e. nothing was submitted
+  bool valid() const { return future.valid(); }
+
+  bool ready() const {
+    return valid() && future.wait_for(chrono::seconds(0)) == future_status::ready;
+  }
+
+  // null while it's still compiling, so the caller can skip / fall back instead of waiting.
+  // Rethrows if the compilation failed
+  ptr<GraphicsPipeline> try_get() const {
+    return ready() ? future.get() : nullptr;
+  }
+
+  // blocks until it's compiled
+  ptr<GraphicsPipeline> get() const {
+    return future.get();
+  }
+};
+
+/***
+ * compiles GraphicsPipelines on a pool of worker threads, so building many variants doesn't block
+ * the main thread (and takes ~1/N of the time on N cores).
+ *
+ * all workers share the device's PipelineCache, pipelines compiled by one thread are cache hits for
+ * the others and are all saved to disk together.
+ */
+class PipelineCompiler {
+  struct Job {
+    PipelineDesc desc;
+    bool use_cache;
+    promise<ptr<GraphicsPipeline>> result;
+  };
+
+  ptr<LogicalDevice> device;
+  vector<thread> workers;
+
+  mutex jobs_mutex;
+  condition_variable jobs_cv;
+  deque<Job> jobs;
+  bool stopping = false;
+
+  void work() {
+    while (true) {
+      Job job;
+      {
+        unique_lock lock(jobs_mutex);
+        jobs_cv.wait(lock, [this]() { return stopping || !jobs.empty(); });
+        if (stopping) {
+          return;
+        }
+
+        job = std::move(jobs.front());
+        jobs.pop_front();
+      }
+
+      try {
+        job.result.set_value(mk_ptr<GraphicsPipeline>(device, job.desc, job.use_cache));
+      } catch (...) {
+        job.result.set_exception(current_exception());
+      }
+
+      compiled += 1;
+    }
+  }
+
+public:
+  atomic<u32> compiled = 0;
+
+  // num_threads == 0: one per core, minus the main thread
+  PipelineCompiler(ptr<LogicalDevice> device, u32 num_threads = 0) : device(device) {
+    if (num_threads == 0) {
+      num_threads = (std::max)(thread::hardware_concurrency(), 2u) - 1;
+    }
+
+    for (u32 i = 0; i < num_threads; ++i) {
+      workers.emplace_back(&PipelineCompiler::work, this);
+    }
+
+    cout << format("PipelineCompiler: {} worker threads\n", num_threads);
+  }
+
+  // jobs that haven't started yet are dropped, their handles throw broken_promise
+  ~PipelineCompiler() {
+    {
+      lock_guard lock(jobs_mutex);
+      stopping = true;
+      jobs.clear();
+    }
+    jobs_cv.notify_all();
+
+    for (auto& worker : workers) {
+      worker.join();
+    }
+  }
+
+  u32 threads() const { return static_cast<u32>(workers.size()); }
+
+  PipelineHandle submit(const PipelineDesc& desc, bool use_cache = true) {
+    Job job{ desc, use_cache };
+    PipelineHandle res(job.result.get_future().share());
+
+    {
+      lock_guard lock(jobs_mutex);
+      jobs.push_back(std::move(job));
+    }
+    jobs_cv.notify_one();
+
+    return res;
+  }
+};
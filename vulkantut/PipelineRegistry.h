@@ -0,0 +1,162 @@
+#pragma once
+
+#include <unordered_map>
+
+#include "LogicalDevice.h"
+#include "GraphicsPipeline.h"
+#include "PipelineCompiler.h"
+
+#include "vulkan_include.h"
+#include "utils.h"
+#include "vk_utils.h"
+
+using namespace std;
+using namespace utils;
+
+// index into a PipelineRegistry, valid as long as the registry and until its pipeline is released
+struct PipelineId {
+  u32 index = UINT_MAX;
+
+  bool valid() const { return index != UINT_MAX; }
+};
+
+/***
+ * every graphics pipeline, each unique combination of state built exactly once.
+ *
+ * a PipelineDesc is reduced to a key of everything that ends up in the VkPipeline: vertex layout,
+ * fixed function state, the shader modules (by the hash of their code, not their path) w/ their
+ * specialization constants, and the render pass, as far as compatibility goes (its format). Two
+ * descs w/ the same key get the same pipeline, even if they came from different places.
+ *
+ * pipelines are built on the compiler's workers if there is one, synchronously otherwise. Either
+ * way callers get a PipelineId, which is just an index.
+ *
+ * the registry holds on to every pipeline (and through it, its render pass) until it's released,
+ * see release()
+ */
+class PipelineRegistry {
+  ptr<LogicalDevice> device;
+  ptr<PipelineCompiler> compiler;
+
+  vector<PipelineHandle> pipelines; // by PipelineId, invalid once released
+  vector<VkFormat> formats; // of their render pass, by PipelineId
+  unordered_map<string, PipelineId> ids; // by key
+
+  template<typename T>
+  static void append(string& key, const T& value) {
+    key.append(reinterpret_cast<const char*>(&value), sizeof(T));
+  }
+
+  string key(const PipelineDesc& desc) {
+    string res;
+
+    append(res, desc.renderpass->format);
+
+    // binding / attribute descriptions are plain u32s, no padding
+    append(res, desc.vertex_layout.bindings.size());
+    for (auto& binding : desc.vertex_layout.bindings) {
+      append(res, binding);
+    }
+    append(res, desc.vertex_layout.attributes.size());
+    for (auto& attribute : desc.vertex_layout.attributes) {
+      append(res, attribute);
+    }
+
+    append(res, desc.topology);
+    append(res, desc.cull_mode);
+    append(res, desc.front_face);
+    append(res, desc.blend);
+
+    append(res, device->shaders->load(desc.vert_shader).hash);
+    append(res, desc.vert_constants.hash());
+    append(res, device->shaders->load(desc.frag_shader).hash);
+    append(res, desc.frag_constants.hash());
+
+    return res;
+  }
+
+public:
+  u32 lookups = 0;
+  u32 hits = 0; // lookups that found an existing pipeline
+
+  PipelineRegistry(ptr<LogicalDevice> device, ptr<PipelineCompiler> compiler = nullptr)
+    : device(device)
+    , compiler(compiler)
+  {}
+
+  // builds the pipeline if it's the first time this combination of state is asked for
+  PipelineId id(const PipelineDesc& desc) {
+    lookups += 1;
+
+    string k = key(desc);
+    if (auto it = ids.find(k); it != ids.end()) {
+      hits += 1;
+      return it->second;
+    }
+
+    if (compiler) {
+      pipelines.push_back(compiler->submit(desc));
+    } else {
+      promise<ptr<GraphicsPipeline>> built;
+      built.set_value(mk_ptr<GraphicsPipeline>(device, desc));
+      pipelines.push_back(PipelineHandle(built.get_future().share()));
+    }
+    formats.push_back(desc.renderpass->format);
+
+    PipelineId res{ static_cast<u32>(pipelines.size() - 1) };
+    ids.emplace(std::move(k), res);
+    return res;
+  }
+
+  PipelineHandle handle(PipelineId id) {
+    PipelineHandle res = pipelines.at(id.index);
+    if (!res.valid()) {
+      throw runtime_error(format("pipeline {} was released", id.index));
+    }
+    return res;
+  }
+
+  PipelineHandle get(const PipelineDesc& desc) {
+    return handle(id(desc));
+  }
+
+  // drops the pipelines for render passes of format, e.g. once the swapchain's format changed.
+  // Whoever still holds one keeps it (and its render pass) alive until they're done w/ it, the
+  // registry doesn't anymore. Asking for the same desc again builds a new one. Pipelines that are
+  // still compiling are dropped once they're done
+  void release(VkFormat format) {
+    for (size_t i = 0; i < pipelines.size(); ++i) {
+      if (formats[i] == format) {
+        pipelines[i] = {};
+      }
+    }
+    std::erase_if(ids, [this](const auto& entry) { return !pipelines[entry.second.index].valid(); });
+  }
+
+  // pipelines currently held
+  u32 unique() const { return static_cast<u32>(ids.size()); }
+
+  // of the pipelines held, failed ones don't count
+  double create_ms() const {
+    double res = 0.0;
+    for (auto& pipeline : pipelines) {
+      try {
+        if (auto built = pipeline.try_get()) {
+          res += built->create_ms;
+        }
+      } catch (const exception&) {
+      }
+    }
+    return res;
+  }
+
+  string to_str() const {
+    return format(
+      "pipeline registry: {} unique pipelines, {} lookups ({} hits), {:.2f} ms creating",
+      unique(),
+      lookups,
+      hits,
+      create_ms()
+    );
+  }
+};
@@ -31,5 +31,14 @@ public:
   bool supports_graphics() const {
     return properties.queueFlags & VK_QUEUE_GRAPHICS_BIT;
   }
+
+  bool supports_compute() const {
+    return properties.queueFlags & VK_QUEUE_COMPUTE_BIT;
+  }
+
+  // graphics and compute families can always transfer, even if they don't say so
+  bool supports_transfer() const {
+    return supports_graphics() || supports_compute() || (properties.queueFlags & VK_QUEUE_TRANSFER_BIT);
+  }
 };
 
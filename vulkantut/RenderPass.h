@@ -14,9 +14,21 @@ class RenderPass {
   ptr<LogicalDevice> device;
 
 public:
+  // pipelines built for one render pass work w/ any other one w/ the same attachment formats
+  // (and sample counts), see "render pass compatibility" in the spec
+  const VkFormat format;
+
   VkRenderPass get() { return render_pass; }
 
-  RenderPass(ptr<LogicalDevice> device, VkFormat format) : device(device) {
+  // final_layout is the layout the image is left in after the pass, PRESENT_SRC for swapchain images,
+  // something else (e.g. TRANSFER_SRC) when rendering offscreen, since there's nothing to present to
+  RenderPass(
+    ptr<LogicalDevice> device,
+    VkFormat format,
+    VkImageLayout final_layout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR
+  ) : device(device)
+    , format(format)
+  {
     cout << "RenderPass() ctor\n";
 
     VkAttachmentDescription colorAttachment{};
@@ -27,7 +39,7 @@ public:
     colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
     colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
     colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    colorAttachment.finalLayout = final_layout;
 
     VkAttachmentReference colorAttachmentRef{};
     colorAttachmentRef.attachment = 0;
@@ -52,6 +64,8 @@ public:
 
   ~RenderPass() {
     cout << "~RenderPass()\n";
-    vkDestroyRenderPass(device->get(), render_pass, nullptr);
+    device->deletion_queue->push([device = device->get(), render_pass = render_pass]() {
+      vkDestroyRenderPass(device, render_pass, nullptr);
+    });
   }
 };
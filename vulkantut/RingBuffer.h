@@ -0,0 +1,88 @@
+#pragma once
+
+#include "LogicalDevice.h"
+#include "Buffer.h"
+
+#include "vulkan_include.h"
+#include "utils.h"
+#include "vk_utils.h"
+
+using namespace std;
+using namespace utils;
+
+/***
+ * one persistently mapped buffer split into a region per frame in flight. Each frame bump-allocates
+ * from its own region, so streaming per-frame data (dynamic vertices, constants, ...) is just a
+ * pointer bump + a memcpy, no allocation and no map / unmap.
+ *
+ * a region is recycled by begin_frame(), which must only be called once the frame's inflight fence
+ * was waited on (see Frame::wait), otherwise the GPU might still be reading what we overwrite.
+ */
+class RingBuffer {
+  ptr<Buffer> buffer;
+  VkDeviceSize region_size;
+  VkDeviceSize alignment;
+
+  VkDeviceSize region_begin = 0;
+  VkDeviceSize offset = 0; // within the current region
+
+public:
+  struct Alloc {
+    VkBuffer buffer;
+    VkDeviceSize offset; // from the start of the buffer, for binding
+    char* data;
+  };
+
+  RingBuffer(
+    ptr<LogicalDevice> device,
+    VkDeviceSize region_size,
+    u32 regions, // == frames in flight
+    VkBufferUsageFlags usage =
+      VK_BUFFER_USAGE_VERTEX_BUFFER_BIT |
+      VK_BUFFER_USAGE_INDEX_BUFFER_BIT |
+      VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT
+  ) {
+    // every allocation is aligned enough to be bound as a uniform buffer
+    alignment = std::max<VkDeviceSize>(
+      device->physical_device->properties().limits.minUniformBufferOffsetAlignment,
+      16
+    );
+
+    this->region_size = (region_size + alignment - 1) & ~(alignment - 1);
+
+    buffer = mk_ptr<Buffer>(
+      device,
+      this->region_size * regions,
+      usage,
+      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
+    );
+  }
+
+  VkBuffer get() { return buffer->get(); }
+
+  void begin_frame(u32 frame_index) {
+    region_begin = region_size * frame_index;
+    offset = 0;
+  }
+
+  Alloc alloc(VkDeviceSize size) {
+    VkDeviceSize aligned = (offset + alignment - 1) & ~(alignment - 1);
+    if (aligned + size > region_size) {
+      throw runtime_error("ring buffer region overflow");
+    }
+
+    offset = aligned + size;
+    return { buffer->get(), region_begin + aligned, buffer->mapped() + region_begin + aligned };
+  }
+
+  Alloc push(const void* data, VkDeviceSize size) {
+    Alloc res = alloc(size);
+    memcpy(res.data, data, size);
+    return res;
+  }
+
+  template<typename T>
+  Alloc push(const vector<T>& data) {
+    return push(data.data(), sizeof(T) * data.size());
+  }
+};
@@ -9,52 +9,124 @@
 using namespace std;
 using namespace utils;
 
-class Shader {
-  ptr<LogicalDevice> device;
-  vector<char> code; 
+// constant_ids of the specialization constants in our shaders
+enum SpecId : u32 {
+  SPEC_LIGHT_COUNT = 0,     // int, shader.frag
+  SPEC_GRAYSCALE = 1,       // bool, shader.frag
+  SPEC_WORKGROUP_SIZE = 2,  // uint, local_size_x_id of compute shaders
+  SPEC_PACKED_VERTICES = 3, // bool, animate.comp
+};
 
-  VkShaderModule shader;
+/***
+ * values for a shader's specialization constants (layout(constant_id = N) const ...), baked into
+ * the pipeline when it's compiled. One SPIR-V module can so be turned into several variants w/o
+ * runtime branches on uniforms; the driver folds the constants and strips the dead code.
+ *
+ * ids the shader doesn't declare are ignored. VkPipelineCache keys on the values too, so every
+ * variant is cached separately
+ */
+class SpecConstants {
+  vector<VkSpecializationMapEntry> entries;
+  vector<char> data;
+  mutable VkSpecializationInfo spec_info{};
 
 public:
-  VkShaderModule get() { return shader; }
-
-  Shader(ptr<LogicalDevice> device, const char* fname) : device(device) {
-    // Unlike earlier APIs, shader code in Vulkan has to be specified in a
-    // bytecode format as opposed to human-readable syntax like GLSL and HLSL.
-    // This bytecode format is called SPIR-V and is designed to be used with both
-    // Vulkan and OpenCL (both Khronos APIs)
-    code = read_file(fname);
-      
-    VkShaderModuleCreateInfo create_info{};
-    create_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-    create_info.codeSize = code.size();
-    create_info.pCode = reinterpret_cast<const u32*>(code.data());
-
-    if (vkCreateShaderModule(device->get(), &create_info, nullptr, &shader) != VK_SUCCESS) {
-      throw runtime_error("failed to create shader module");
+  // T must match the type the shader declares. bool is stored as a VkBool32, like SPIR-V wants it
+  template<typename T>
+    requires is_arithmetic_v<T>
+  SpecConstants& set(u32 id, T value) {
+    if constexpr (is_same_v<T, bool>) {
+      return set<VkBool32>(id, value ? VK_TRUE : VK_FALSE);
+    } else {
+      for (auto& entry : entries) {
+        if (entry.constantID == id) {
+          if (entry.size != sizeof(T)) {
+            throw runtime_error(format("specialization constant {} was set w/ a type of another size", id));
+          }
+          memcpy(data.data() + entry.offset, &value, sizeof(T));
+          return *this;
+        }
+      }
+
+      // entries are kept sorted by id, so the same constants set in another order hash & compare
+      // the same. data stays in insertion order, the entries point into it
+      auto it = lower_bound(
+        entries.begin(),
+        entries.end(),
+        id,
+        [](const VkSpecializationMapEntry& entry, u32 key) { return entry.constantID < key; }
+      );
+      it = entries.insert(it, { id, static_cast<u32>(data.size()), sizeof(T) });
+      data.resize(data.size() + sizeof(T));
+      memcpy(data.data() + it->offset, &value, sizeof(T));
+      return *this;
     }
   }
 
-  ~Shader() {
-    vkDestroyShaderModule(device->get(), shader, nullptr);
+  bool empty() const { return entries.empty(); }
+
+  // points into this, must outlive the pipeline creation it's used for
+  const VkSpecializationInfo* info() const {
+    spec_info.mapEntryCount = static_cast<u32>(entries.size());
+    spec_info.pMapEntries = entries.data();
+    spec_info.dataSize = data.size();
+    spec_info.pData = data.data();
+    return &spec_info;
+  }
+
+  // FNV-1a over ids & values, in id order, for keying pipelines by their constants
+  uint64_t hash() const {
+    uint64_t h = 14695981039346656037ull;
+    auto mix = [&h](const void* bytes, size_t size) {
+      for (size_t i = 0; i < size; ++i) {
+        h = (h ^ static_cast<const unsigned char*>(bytes)[i]) * 1099511628211ull;
+      }
+    };
+
+    for (auto& entry : entries) {
+      mix(&entry.constantID, sizeof(entry.constantID));
+      mix(data.data() + entry.offset, entry.size);
+    }
+    return h;
   }
 
-  // There is one more (optional) member, pSpecializationInfo, which we won't
-  // be using here, but is worth discussing. It allows you to specify values
-  // for shader constants. You can use a single shader module where its
-  // behavior can be configured at pipeline creation by specifying different
-  // values for the constants used in it. This is more efficient than
-  // configuring the shader using variables at render time, because the
-  // compiler can do optimizations like eliminating if statements that depend
-  // on these values. If you don't have any constants like that, then you can
-  // set the member to nullptr, which our struct initialization does
-  // automatically.
-  VkPipelineShaderStageCreateInfo pipeline_stage(VkShaderStageFlagBits stage) {
+  bool operator==(const SpecConstants& other) const {
+    if (entries.size() != other.entries.size()) {
+      return false;
+    }
+
+    for (size_t i = 0; i < entries.size(); ++i) {
+      auto& a = entries[i];
+      auto& b = other.entries[i];
+      if (a.constantID != b.constantID || a.size != b.size ||
+          memcmp(data.data() + a.offset, other.data.data() + b.offset, a.size) != 0) {
+        return false;
+      }
+    }
+    return true;
+  }
+};
+
+// a shader module from the device's ShaderLibrary, which owns it. Cheap, every pipeline
+// constructs its own
+class Shader {
+  ShaderModule module;
+
+public:
+  VkShaderModule get() { return module.module; }
+  uint64_t hash() const { return module.hash; }
+
+  Shader(ptr<LogicalDevice> device, const string& fname) : module(device->shaders->load(fname)) {}
+
+  // constants (optional) specialize the module for this pipeline, see SpecConstants. They must
+  // outlive the vkCreate*Pipelines call the result is used in
+  VkPipelineShaderStageCreateInfo pipeline_stage(VkShaderStageFlagBits stage, const SpecConstants* constants = nullptr) {
     VkPipelineShaderStageCreateInfo res{};
     res.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
     res.stage = stage;
-    res.module = shader; // specify the code to run
+    res.module = module.module; // specify the code to run
     res.pName = "main"; // entrypoint of in the code
+    res.pSpecializationInfo = constants && !constants->empty() ? constants->info() : nullptr;
     return res;
   }
 };
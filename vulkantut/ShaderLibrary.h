@@ -0,0 +1,205 @@
+#pragma once
+
+#include <mutex>
+#include <unordered_map>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "vulkan_include.h"
+#include "utils.h"
+
+using namespace std;
+using namespace utils;
+
+/***
+ * read-only memory mapping of a whole file. The OS pages it in straight from the file cache, no
+ * ifstream buffering and no copy into a vector
+ */
+class MappedFile {
+  const char* bytes = nullptr;
+  size_t length = 0;
+
+#ifdef _WIN32
+  HANDLE file = INVALID_HANDLE_VALUE;
+  HANDLE mapping = nullptr;
+#endif
+
+public:
+  const char* data() const { return bytes; }
+  size_t size() const { return length; }
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  MappedFile(const string& path) {
+#ifdef _WIN32
+    file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+      throw runtime_error(format("failed to open {}", path));
+    }
+
+    LARGE_INTEGER file_size{};
+    GetFileSizeEx(file, &file_size);
+    length = static_cast<size_t>(file_size.QuadPart);
+    if (length == 0) {
+      return; // can't map an empty file
+    }
+
+    mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping == nullptr) {
+      CloseHandle(file);
+      throw runtime_error(format("failed to map {}", path));
+    }
+
+    bytes = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+    if (bytes == nullptr) {
+      CloseHandle(mapping);
+      CloseHandle(file);
+      throw runtime_error(format("failed to map {}", path));
+    }
+#else
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+      throw runtime_error(format("failed to open {}", path));
+    }
+
+    struct stat st{};
+    fstat(fd, &st);
+    length = static_cast<size_t>(st.st_size);
+    if (length > 0) {
+      void* addr = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (addr == MAP_FAILED) {
+        close(fd);
+        throw runtime_error(format("failed to map {}", path));
+      }
+      bytes = static_cast<const char*>(addr);
+    }
+    close(fd); // the mapping stays valid
+#endif
+  }
+
+  ~MappedFile() {
+#ifdef _WIN32
+    if (bytes) {
+      UnmapViewOfFile(bytes);
+    }
+    if (mapping) {
+      CloseHandle(mapping);
+    }
+    CloseHandle(file);
+#else
+    if (bytes) {
+      munmap(const_cast<char*>(bytes), length);
+    }
+#endif
+  }
+};
+
+struct ShaderModule {
+  VkShaderModule module;
+  uint64_t hash; // of the SPIR-V, identifies the module
+};
+
+/***
+ * every VkShaderModule of the device, loaded once and shared by all the pipelines using it.
+ *
+ * modules are keyed by a hash of their SPIR-V, so two paths w/ the same code share a module too.
+ * Paths that were already loaded don't touch the file system at all. Modules live as long as the
+ * device, which is fine for the handful of shaders we have.
+ *
+ * thread safe, pipelines are compiled from several threads (see PipelineCompiler)
+ */
+class ShaderLibrary {
+  VkDevice device;
+
+  mutable mutex lib_mutex;
+  unordered_map<string, uint64_t> hash_by_path;
+  unordered_map<uint64_t, VkShaderModule> modules; // by hash
+
+  // FNV-1a
+  static uint64_t hash(const char* data, size_t size) {
+    uint64_t h = 14695981039346656037ull;
+    for (size_t i = 0; i < size; ++i) {
+      h = (h ^ static_cast<unsigned char>(data[i])) * 1099511628211ull;
+    }
+    return h;
+  }
+
+public:
+  u32 hits = 0;   // path already loaded
+  u32 misses = 0; // path read from disk
+  u32 shared = 0; // misses whose code was already loaded from another path
+  size_t loaded_bytes = 0;
+  double load_ms = 0.0; // spent mapping, hashing & creating modules
+
+  ShaderLibrary(VkDevice device) : device(device) {}
+
+  ~ShaderLibrary() {
+    for (auto& [_, module] : modules) {
+      vkDestroyShaderModule(device, module, nullptr);
+    }
+  }
+
+  ShaderModule load(const string& path) {
+    lock_guard lock(lib_mutex);
+
+    if (auto it = hash_by_path.find(path); it != hash_by_path.end()) {
+      hits += 1;
+      return { modules.at(it->second), it->second };
+    }
+
+    auto start = chrono::steady_clock::now();
+    misses += 1;
+
+    // Unlike earlier APIs, shader code in Vulkan has to be specified in a
+    // bytecode format as opposed to human-readable syntax like GLSL and HLSL.
+    // This bytecode format is called SPIR-V and is designed to be used with both
+    // Vulkan and OpenCL (both Khronos APIs)
+    MappedFile file(path);
+    if (file.size() == 0 || file.size() % 4 != 0) {
+      throw runtime_error(format("{} is not SPIR-V", path));
+    }
+
+    uint64_t h = hash(file.data(), file.size());
+
+    if (modules.contains(h)) {
+      shared += 1;
+    } else {
+      // the mapping is page aligned, so it's aligned enough to be read as u32s
+      VkShaderModuleCreateInfo create_info{};
+      create_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+      create_info.codeSize = file.size();
+      create_info.pCode = reinterpret_cast<const u32*>(file.data());
+
+      VkShaderModule module;
+      if (vkCreateShaderModule(device, &create_info, nullptr, &module) != VK_SUCCESS) {
+        throw runtime_error(format("failed to create shader module for {}", path));
+      }
+
+      modules[h] = module;
+      loaded_bytes += file.size();
+    }
+    hash_by_path[path] = h;
+
+    load_ms += chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    return { modules.at(h), h };
+  }
+
+  string to_str() const {
+    lock_guard lock(lib_mutex);
+    return format(
+      "shader library: {} modules ({} bytes), {} hits, {} misses ({} shared), {:.2f} ms loading",
+      modules.size(),
+      loaded_bytes,
+      hits,
+      misses,
+      shared,
+      load_ms
+    );
+  }
+};
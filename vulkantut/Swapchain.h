@@ -10,6 +10,31 @@
 using namespace std;
 using namespace utils;
 
+// how frames get to the screen, trading latency for throughput / tearing
+enum class PresentPolicy {
+  low_latency, // MAILBOX: a newer frame replaces the queued one, no tearing. Else FIFO w/ the fewest images
+  vsync,       // FIFO w/ a spare image: every frame is shown and the GPU doesn't wait, but frames queue up
+  uncapped,    // IMMEDIATE: shown as soon as it's done, tears. Falls back to MAILBOX, then FIFO
+};
+
+inline string to_str(PresentPolicy policy) {
+  switch (policy) {
+    case PresentPolicy::low_latency: return "low-latency";
+    case PresentPolicy::vsync: return "vsync";
+    case PresentPolicy::uncapped: return "uncapped";
+  }
+  return "?";
+}
+
+inline PresentPolicy present_policy(const string& name) {
+  for (auto policy : { PresentPolicy::low_latency, PresentPolicy::vsync, PresentPolicy::uncapped }) {
+    if (to_str(policy) == name) {
+      return policy;
+    }
+  }
+  throw runtime_error(format("unknown present policy {}", name));
+}
+
 /***
  * swapchain == list of image buffers that are eventually displayed to the user
  * 
@@ -25,17 +50,41 @@ public:
   VkSwapchainKHR swapchain;
   VkFormat format;
   VkExtent2D extent;
+  PresentPolicy policy;
+  VkPresentModeKHR present_mode;
+  u32 image_count;
+
+  // id of the last present, if the device has present wait (see Frame::draw, wait_presented())
+  uint64_t present_id = 0;
+
+  // per image, the fence of the frame that last rendered to it (VK_NULL_HANDLE if none did yet).
+  // Frames in flight and images aren't 1:1, and images can be acquired in any order, so a frame
+  // must wait on this before rendering to the image it acquired, see Frame::draw
+  vector<VkFence> images_inflight;
+
+  // same, as the frame's serial, w/ the device's graphics_timeline instead of fences (0 if none)
+  vector<uint64_t> images_inflight_frames;
 
   VkSwapchainKHR get() { return swapchain; }
 
   ~Swapchain() {
     cout << "~SwapChain()\n";
-    vkDestroySwapchainKHR(device->get(), swapchain, nullptr);
+    device->deletion_queue->push([device = device->get(), swapchain = swapchain]() {
+      vkDestroySwapchainKHR(device, swapchain, nullptr);
+    });
   }
 
-  Swapchain(ptr<LogicalDevice> device, ptr<Surface> surface)
-    : device(device)
+  // old: the swapchain this one replaces (e.g. on resize). It's retired by this, nothing can be
+  // acquired from it anymore, but images already acquired / presented from it stay valid, so frames
+  // in flight can finish w/ them. It must be kept alive until they did
+  Swapchain(
+    ptr<LogicalDevice> device,
+    ptr<Surface> surface,
+    PresentPolicy policy = PresentPolicy::low_latency,
+    Swapchain* old = nullptr
+  ) : device(device)
     , surface(surface)
+    , policy(policy)
   {
     cout << "SwapChain() ctor\n";
 
@@ -63,7 +112,29 @@ public:
     extent = surface_capabilities.currentExtent;
     create_info.imageExtent = surface_capabilities.currentExtent;
 
-    create_info.minImageCount = surface_capabilities.minImageCount + 1; // TODO capabilities.maxImageCount
+    auto modes = device->physical_device->surface_present_modes(surface->get());
+    auto supported = [&modes](VkPresentModeKHR mode) {
+      return find(modes, [mode](auto m) { return m == mode; }).has_value();
+    };
+
+    // The presentMode member speaks for itself. FIFO is the only one that's always supported
+    present_mode = VK_PRESENT_MODE_FIFO_KHR;
+    if (policy == PresentPolicy::uncapped && supported(VK_PRESENT_MODE_IMMEDIATE_KHR)) {
+      present_mode = VK_PRESENT_MODE_IMMEDIATE_KHR;
+    } else if (policy != PresentPolicy::vsync && supported(VK_PRESENT_MODE_MAILBOX_KHR)) {
+      present_mode = VK_PRESENT_MODE_MAILBOX_KHR;
+    }
+
+    // every image more than the minimum is one more frame that can be queued. FIFO w/ low latency
+    // goes w/o, the rest need one to render into while the others are presented / queued
+    image_count = surface_capabilities.minImageCount;
+    if (policy != PresentPolicy::low_latency || present_mode != VK_PRESENT_MODE_FIFO_KHR) {
+      image_count += 1;
+    }
+    if (surface_capabilities.maxImageCount > 0) { // 0 == no limit
+      image_count = (std::min)(image_count, surface_capabilities.maxImageCount);
+    }
+    create_info.minImageCount = image_count;
 
     //We can specify that a certain transform should be applied to images in the
     //swap chain if it is supported (supportedTransforms in capabilities), like
@@ -84,22 +155,35 @@ public:
     // VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR.
     create_info.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
 
-    // The presentMode member speaks for itself. If the clipped member is set to
+    // If the clipped member is set to
     // VK_TRUE then that means that we don't care about the color of pixels that are
     // obscured, for example because another window is in front of them. Unless you
     // really need to be able to read these pixels back and get predictable results,
     // you'll get the best performance by enabling clipping.
-    create_info.presentMode = find(
-      device->physical_device->surface_present_modes(surface->get()),
-      [](const VkPresentModeKHR& mode) { return mode == VK_PRESENT_MODE_MAILBOX_KHR; }
-    ).value_or(VK_PRESENT_MODE_FIFO_KHR);
+    create_info.presentMode = present_mode;
 
     create_info.clipped = VK_TRUE;
-    create_info.oldSwapchain = VK_NULL_HANDLE;
+    create_info.oldSwapchain = old ? old->get() : VK_NULL_HANDLE;
 
     if (vkCreateSwapchainKHR(device->get(), &create_info, nullptr, &swapchain) != VK_SUCCESS) {
       throw runtime_error("failed to create swap chain");
     }
+
+    // the implementation may create more than asked for
+    vkGetSwapchainImagesKHR(device->get(), swapchain, &image_count, nullptr);
+    images_inflight.assign(image_count, VK_NULL_HANDLE);
+    images_inflight_frames.assign(image_count, 0);
+
+    cout << format("present policy {}: mode {}, {} images\n", to_str(policy), static_cast<int>(present_mode), image_count);
+  }
+
+  // blocks until the last present is on screen, so the next frame starts from the newest input
+  // instead of queueing behind it. Timeouts / errors are ignored, the next present reports them.
+  // No-op w/o present wait
+  void wait_presented(uint64_t timeout_ns = 100'000'000) {
+    if (device->present_wait && present_id > 0) {
+      device->wait_for_present(swapchain, present_id, timeout_ns);
+    }
   }
 
   //vector<ptr<ImageView>> imageviews() {
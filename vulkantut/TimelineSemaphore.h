@@ -0,0 +1,63 @@
+#pragma once
+
+#include "vulkan_include.h"
+#include "utils.h"
+
+using namespace std;
+using namespace utils;
+
+/***
+ * a semaphore w/ a 64 bit counter instead of a signaled / unsignaled state (Vulkan 1.2). Every
+ * submission to a queue signals the next value, so "is submission N done" is a single comparison
+ * against completed(), and one semaphore tracks the whole queue instead of a fence per frame.
+ * Nothing to reset either.
+ *
+ * can't be used for presentation, acquire / present still need binary semaphores
+ */
+class TimelineSemaphore {
+  VkDevice device;
+  VkSemaphore sema;
+
+public:
+  VkSemaphore get() { return sema; }
+
+  TimelineSemaphore(VkDevice device, uint64_t initial_value = 0) : device(device) {
+    VkSemaphoreTypeCreateInfo type_info{};
+    type_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+    type_info.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+    type_info.initialValue = initial_value;
+
+    VkSemaphoreCreateInfo create_info{};
+    create_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    create_info.pNext = &type_info;
+
+    if (vkCreateSemaphore(device, &create_info, nullptr, &sema) != VK_SUCCESS) {
+      throw runtime_error("failed to create timeline semaphore");
+    }
+  }
+
+  ~TimelineSemaphore() {
+    vkDestroySemaphore(device, sema, nullptr);
+  }
+
+  // the highest value signaled so far
+  uint64_t completed() const {
+    uint64_t value = 0;
+    vkGetSemaphoreCounterValue(device, sema, &value);
+    return value;
+  }
+
+  // blocks until value is signaled. Doesn't call into the driver's wait if it already was
+  void wait(uint64_t value) const {
+    if (completed() >= value) {
+      return;
+    }
+
+    VkSemaphoreWaitInfo wait_info{};
+    wait_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+    wait_info.semaphoreCount = 1;
+    wait_info.pSemaphores = &sema;
+    wait_info.pValues = &value;
+    vkWaitSemaphores(device, &wait_info, UINT64_MAX);
+  }
+};
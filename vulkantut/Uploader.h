@@ -0,0 +1,289 @@
+#pragma once
+
+#include "LogicalDevice.h"
+#include "Buffer.h"
+#include "Command.h"
+#include "Fence.h"
+#include "Sema.h"
+
+#include "vulkan_include.h"
+#include "utils.h"
+#include "vk_utils.h"
+
+using namespace std;
+using namespace utils;
+
+/***
+ * gets data into DEVICE_LOCAL memory, which (on discrete GPUs) the CPU can't write to directly.
+ *
+ * upload() memcpys into a persistently mapped staging buffer and queues a vkCmdCopyBuffer from it,
+ * flush() records all the queued copies into one command buffer and submits it once, w/o waiting
+ * for it. So N buffers cost one submission, not N. The staging buffer is reused after each flush,
+ * the first upload() of the next batch waits for the previous one's copies (one fence).
+ *
+ * later submissions to graphics_q are ordered after the copies on the GPU (see flush()), so drawing
+ * w/ the buffers needs no wait on the CPU. Anything else waits on the id flush() returns, see wait()
+ *
+ * copies go to the device's transfer queue. If that's a dedicated family, the buffers are released
+ * from it at the end of the copies and acquired by the graphics family in a second, tiny submission
+ * on graphics_q that waits on the first (queue family ownership transfer). Until then, graphics_q
+ * keeps rendering while the copy engine works. Buffers are meant to be uploaded to once, after
+ * they're created: whatever graphics_q wrote to one before isn't carried over
+ */
+class Uploader {
+  struct Copy {
+    VkBuffer dst;
+    VkBufferCopy region;
+  };
+
+  ptr<LogicalDevice> device;
+  ptr<Command> command; // on the transfer family
+  ptr<Fence> fence;
+
+  // only w/ a dedicated transfer family: the acquiring side of the ownership transfers
+  ptr<Command> acquire_command; // on the graphics family
+  ptr<Sema> released;
+
+  ptr<Buffer> staging;
+  VkDeviceSize staging_used = 0;
+  vector<Copy> pending;
+
+  u32 completed = 0; // the last flush known to be done, see wait()
+
+  ptr<Buffer> mk_staging(VkDeviceSize size) {
+    return mk_ptr<Buffer>(
+      device,
+      size,
+      VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
+    );
+  }
+
+public:
+  u32 submissions = 0; // also the id of the last flush()
+  VkDeviceSize bytes_uploaded = 0;
+
+  // buffers are uploaded on the device's transfer_q, for use on its graphics_q
+  Uploader(
+    ptr<LogicalDevice> device,
+    VkDeviceSize staging_size = 16 * 1024 * 1024
+  ) : device(device)
+  {
+    command = mk_ptr<Command>(device, device->transfer_qfam, 1);
+    fence = mk_ptr<Fence>(device);
+    staging = mk_staging(staging_size);
+
+    if (transfers_ownership()) {
+      acquire_command = mk_ptr<Command>(device, device->graphics_qfam, 1);
+      released = mk_ptr<Sema>(device);
+    }
+  }
+
+  // the copies run on another family than the one the buffers are used on
+  bool transfers_ownership() const {
+    return device->transfer_qfam != device->graphics_qfam;
+  }
+
+  ~Uploader() {
+    if (!pending.empty()) {
+      cout << format("~Uploader(): {} uploads were never flushed\n", pending.size());
+    }
+    wait(submissions); // the command buffer / staging buffer might still be in use
+  }
+
+  // dst must have been created w/ VK_BUFFER_USAGE_TRANSFER_DST_BIT. Only queues the copy,
+  // dst can't be used before flush()
+  void upload(VkBuffer dst, const void* data, VkDeviceSize size, VkDeviceSize dst_offset = 0) {
+    if (staging_used + size > staging->size) {
+      flush();
+    }
+
+    // a new batch: the staging buffer is written from the start again, the previous flush's copies
+    // must be done reading it (and w/ the command buffer)
+    if (pending.empty()) {
+      wait(submissions);
+
+      if (size > staging->size) {
+        staging = mk_staging(size);
+      }
+    }
+
+    memcpy(staging->mapped() + staging_used, data, size);
+
+    VkBufferCopy region{};
+    region.srcOffset = staging_used;
+    region.dstOffset = dst_offset;
+    region.size = size;
+    pending.push_back({ dst, region });
+
+    staging_used += size;
+  }
+
+  // submits all queued copies, doesn't wait for them. They end w/ a barrier (the acquire w/ a
+  // dedicated transfer family, on graphics_q) that orders whatever's submitted to graphics_q later
+  // after them, so frames can draw w/ the buffers right away. Returns the id to wait() on before
+  // using them any other way, e.g. on another queue
+  u32 flush() {
+    if (pending.empty()) {
+      return submissions;
+    }
+
+    VkCommandBuffer buffer = command->get_buffer(0);
+    vkResetCommandBuffer(buffer, 0);
+
+    VkCommandBufferBeginInfo begin_info{};
+    begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+    if (vkBeginCommandBuffer(buffer, &begin_info) != VK_SUCCESS) {
+      throw runtime_error("failed to begin recording upload command buffer");
+    }
+
+    for (auto& copy : pending) {
+      vkCmdCopyBuffer(buffer, staging->get(), copy.dst, 1, &copy.region);
+      bytes_uploaded += copy.region.size;
+    }
+
+    device->reset_fence(fence->get());
+
+    if (transfers_ownership()) {
+      submit_transferred(buffer);
+    } else {
+      // make the copies visible to whatever reads the buffers next (vertex input, shaders, ...)
+      VkMemoryBarrier barrier{};
+      barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+      barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+      barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+      vkCmdPipelineBarrier(
+        buffer,
+        VK_PIPELINE_STAGE_TRANSFER_BIT,
+        VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+        0,
+        1, &barrier,
+        0, nullptr,
+        0, nullptr
+      );
+
+      if (vkEndCommandBuffer(buffer) != VK_SUCCESS) {
+        throw runtime_error("failed to record upload command buffer");
+      }
+
+      VkSubmitInfo submit_info{};
+      submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+      submit_info.commandBufferCount = 1;
+      submit_info.pCommandBuffers = &buffer;
+
+      if (vkQueueSubmit(device->transfer_q, 1, &submit_info, fence->get()) != VK_SUCCESS) {
+        throw runtime_error("failed to submit upload command buffer");
+      }
+    }
+
+    submissions += 1;
+    staging_used = 0;
+    pending.clear();
+    return submissions;
+  }
+
+  // whether the copies of flush() id (and of every flush before) are done
+  bool done(u32 id) {
+    if (id > completed && vkGetFenceStatus(device->get(), fence->get()) == VK_SUCCESS) {
+      completed = submissions; // one flush in flight at most, see upload()
+    }
+    return id <= completed;
+  }
+
+  // blocks until the copies of flush() id (and of every flush before) are done
+  void wait(u32 id) {
+    if (id > completed) {
+      device->wait_fence(fence->get());
+      completed = submissions;
+    }
+  }
+
+private:
+  // ends buffer (the copies) w/ the release of every copied range, submits it to transfer_q, then
+  // the matching acquires to graphics_q behind the released semaphore. The fence goes w/ the latter
+  void submit_transferred(VkCommandBuffer buffer) {
+    vector<VkBufferMemoryBarrier> releases;
+    vector<VkBufferMemoryBarrier> acquires;
+    for (auto& copy : pending) {
+      releases.push_back(vk_ownership_barrier(
+        copy.dst, copy.region.dstOffset, copy.region.size,
+        device->transfer_qfam, device->graphics_qfam,
+        VK_ACCESS_TRANSFER_WRITE_BIT, 0
+      ));
+      acquires.push_back(vk_ownership_barrier(
+        copy.dst, copy.region.dstOffset, copy.region.size,
+        device->transfer_qfam, device->graphics_qfam,
+        0, VK_ACCESS_MEMORY_READ_BIT
+      ));
+    }
+
+    vkCmdPipelineBarrier(
+      buffer,
+      VK_PIPELINE_STAGE_TRANSFER_BIT,
+      VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+      0,
+      0, nullptr,
+      static_cast<u32>(releases.size()), releases.data(),
+      0, nullptr
+    );
+
+    if (vkEndCommandBuffer(buffer) != VK_SUCCESS) {
+      throw runtime_error("failed to record upload command buffer");
+    }
+
+    VkSemaphore released_sema = released->get();
+
+    VkSubmitInfo copy_info{};
+    copy_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    copy_info.commandBufferCount = 1;
+    copy_info.pCommandBuffers = &buffer;
+    copy_info.signalSemaphoreCount = 1;
+    copy_info.pSignalSemaphores = &released_sema;
+
+    if (vkQueueSubmit(device->transfer_q, 1, &copy_info, VK_NULL_HANDLE) != VK_SUCCESS) {
+      throw runtime_error("failed to submit upload command buffer");
+    }
+
+    VkCommandBuffer acquire = acquire_command->get_buffer(0);
+    vkResetCommandBuffer(acquire, 0);
+
+    VkCommandBufferBeginInfo begin_info{};
+    begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+    if (vkBeginCommandBuffer(acquire, &begin_info) != VK_SUCCESS) {
+      throw runtime_error("failed to begin recording acquire command buffer");
+    }
+
+    // later submissions to graphics_q are ordered after this, whatever reads the buffers next
+    vkCmdPipelineBarrier(
+      acquire,
+      VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+      VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+      0,
+      0, nullptr,
+      static_cast<u32>(acquires.size()), acquires.data(),
+      0, nullptr
+    );
+
+    if (vkEndCommandBuffer(acquire) != VK_SUCCESS) {
+      throw runtime_error("failed to record acquire command buffer");
+    }
+
+    VkPipelineStageFlags wait_stage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+
+    VkSubmitInfo acquire_info{};
+    acquire_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    acquire_info.waitSemaphoreCount = 1;
+    acquire_info.pWaitSemaphores = &released_sema;
+    acquire_info.pWaitDstStageMask = &wait_stage;
+    acquire_info.commandBufferCount = 1;
+    acquire_info.pCommandBuffers = &acquire;
+
+    if (vkQueueSubmit(device->graphics_q, 1, &acquire_info, fence->get()) != VK_SUCCESS) {
+      throw runtime_error("failed to submit acquire command buffer");
+    }
+  }
+};
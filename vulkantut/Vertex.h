@@ -1,21 +1,41 @@
 #pragma once
 
 #include <glm/glm.hpp>
+#include <glm/gtc/packing.hpp>
 #include <array>
+#include <vector>
+#include <concepts>
 
 #include "vulkan_include.h"
 
 using namespace std;
 
+/***
+ * a vertex type describes its own layout: binding_desc() / attr_desc() for the pipeline, and
+ * from() to build it out of the full precision Vertex (so meshes can be authored once and then
+ * stored in whichever format). Pick one per mesh at compile time, see VertexLayout::of<V>()
+ */
+struct Vertex;
+
+template<typename V>
+concept VertexType = requires(const Vertex& v) {
+  { V::binding_desc() } -> std::same_as<VkVertexInputBindingDescription>;
+  V::attr_desc();
+  { V::from(v) } -> std::same_as<V>;
+};
+
+// 20 bytes
 struct Vertex {
   glm::vec2 pos;
   glm::vec3 color;
 
+  static Vertex from(const Vertex& v) { return v; }
+
   static VkVertexInputBindingDescription binding_desc() {
     VkVertexInputBindingDescription desc{};
     desc.binding = 0; // index of binding in array of bindings
     desc.stride = sizeof(Vertex); // num byes from one entry to the next
-    desc.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;  // move to the next data entry after each vertex (vs. "instanced rendering" (?))
+    desc.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;  // move to the next data entry after each vertex (vs. after each instance, see Instance)
 
     return desc;
   }
@@ -46,3 +66,98 @@ struct Vertex {
     return desc;
   }
 };
+
+// 8 bytes: half float position, RGBA8 unorm color. The vertex fetch unit converts both back to
+// floats, so the shader is the same one as for Vertex
+struct PackedVertex {
+  uint32_t pos;   // 2 x half
+  uint32_t color; // R8G8B8A8_UNORM
+
+  static PackedVertex from(const Vertex& v) {
+    return {
+      glm::packHalf2x16(v.pos),
+      glm::packUnorm4x8(glm::vec4(v.color, 1.0f))
+    };
+  }
+
+  static VkVertexInputBindingDescription binding_desc() {
+    VkVertexInputBindingDescription desc{};
+    desc.binding = 0;
+    desc.stride = sizeof(PackedVertex);
+    desc.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+    return desc;
+  }
+
+  static array<VkVertexInputAttributeDescription, 2> attr_desc() {
+    array<VkVertexInputAttributeDescription, 2> desc{};
+
+    desc[0].binding = 0;
+    desc[0].location = 0;
+    desc[0].format = VK_FORMAT_R16G16_SFLOAT;
+    desc[0].offset = offsetof(PackedVertex, pos);
+
+    desc[1].binding = 0;
+    desc[1].location = 1;
+    desc[1].format = VK_FORMAT_R8G8B8A8_UNORM; // shader reads it as a vec3, alpha is dropped
+    desc[1].offset = offsetof(PackedVertex, color);
+
+    return desc;
+  }
+};
+
+// 24 bytes, per-instance data on binding 1: placement and tint of one copy of the mesh. Drawing N
+// copies is then one draw call w/ instanceCount N, see shaders/instanced.vert
+struct Instance {
+  glm::vec2 offset;
+  float scale;
+  glm::vec3 color; // multiplies the vertex color
+
+  static VkVertexInputBindingDescription binding_desc() {
+    VkVertexInputBindingDescription desc{};
+    desc.binding = 1;
+    desc.stride = sizeof(Instance);
+    desc.inputRate = VK_VERTEX_INPUT_RATE_INSTANCE; // next entry after each instance
+    return desc;
+  }
+
+  // locations 3+, after the ones of any vertex type
+  static array<VkVertexInputAttributeDescription, 2> attr_desc() {
+    array<VkVertexInputAttributeDescription, 2> desc{};
+
+    desc[0].binding = 1;
+    desc[0].location = 3;
+    desc[0].format = VK_FORMAT_R32G32B32_SFLOAT; // offset + scale
+    desc[0].offset = offsetof(Instance, offset);
+
+    desc[1].binding = 1;
+    desc[1].location = 4;
+    desc[1].format = VK_FORMAT_R32G32B32_SFLOAT;
+    desc[1].offset = offsetof(Instance, color);
+
+    return desc;
+  }
+};
+
+/***
+ * runtime form of a vertex type's layout, what the pipeline's vertex input state is built from
+ */
+struct VertexLayout {
+  vector<VkVertexInputBindingDescription> bindings;
+  vector<VkVertexInputAttributeDescription> attributes;
+
+  template<VertexType V>
+  static VertexLayout of() {
+    auto attrs = V::attr_desc();
+    return { { V::binding_desc() }, { attrs.begin(), attrs.end() } };
+  }
+
+  // this + a per-instance binding, e.g. instanced<Instance>()
+  template<typename I>
+  VertexLayout instanced() const {
+    VertexLayout res = *this;
+    res.bindings.push_back(I::binding_desc());
+    auto attrs = I::attr_desc();
+    res.attributes.insert(res.attributes.end(), attrs.begin(), attrs.end());
+    return res;
+  }
+};
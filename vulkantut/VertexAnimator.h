@@ -0,0 +1,130 @@
+#pragma once
+
+#include "LogicalDevice.h"
+#include "Buffer.h"
+#include "Uploader.h"
+#include "ComputePipeline.h"
+#include "VertexBuffer.h"
+#include "Vertex.h"
+
+#include "vulkan_include.h"
+#include "utils.h"
+#include "vk_utils.h"
+
+using namespace std;
+using namespace utils;
+
+/***
+ * rotates a mesh on the GPU: a compute pass writes the rotated vertices into a DEVICE_LOCAL vertex
+ * buffer that's then drawn, instead of the CPU writing them into the RingBuffer every frame. The CPU
+ * side of a frame is then one float, whatever the num of vertices, and they never cross the bus.
+ *
+ * one output region (+ angle) per frame in flight, like the RingBuffer: a region is only rewritten
+ * once the previous submission that drew it is done (see Frame::wait). The recorded commands only
+ * depend on the region, not on the angle, so cached command buffers stay valid (see CommandCache)
+ */
+class VertexAnimator {
+  // matches animate.comp
+  struct Push {
+    u32 num_vertices;
+  };
+
+  static constexpr u32 group_size = 64; // local_size_x of animate.comp, through SPEC_WORKGROUP_SIZE
+
+  ptr<LogicalDevice> device;
+  ptr<ComputePipeline> pipeline;
+  ptr<Buffer> source; // the mesh, as Vertex
+  ptr<Buffer> output; // a region of num_vertices vertices per frame in flight
+  ptr<Buffer> params; // a region w/ the angle per frame in flight, written by the CPU
+  vector<VkDescriptorSet> sets; // per region
+  VkDeviceSize output_region;
+  VkDeviceSize params_region;
+  u32 num_vertices;
+  u32 region = 0;
+
+  VkDeviceSize align(VkDeviceSize size) const {
+    VkDeviceSize alignment = device->physical_device->properties().limits.minStorageBufferOffsetAlignment;
+    return (size + alignment - 1) & ~(alignment - 1);
+  }
+
+public:
+  // vertices are uploaded, uploader->flush() before the first frame. packed: writes PackedVertex
+  // instead of Vertex, whichever the pipeline drawing them was built for
+  VertexAnimator(
+    ptr<LogicalDevice> device,
+    ptr<Uploader> uploader,
+    const vector<Vertex>& vertices,
+    u32 regions, // >= frames in flight
+    bool packed
+  ) : device(device)
+    , num_vertices(static_cast<u32>(vertices.size()))
+  {
+    SpecConstants constants;
+    constants.set(SPEC_PACKED_VERTICES, packed);
+    constants.set(SPEC_WORKGROUP_SIZE, group_size);
+    pipeline = mk_ptr<ComputePipeline>(
+      device,
+      "shaders/animate_comp.spv",
+      3,
+      static_cast<u32>(sizeof(Push)),
+      regions,
+      &constants
+    );
+
+    VkDeviceSize source_size = sizeof(Vertex) * (std::max)(num_vertices, 1u);
+    source = mk_ptr<Buffer>(
+      device,
+      source_size,
+      VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
+    );
+    if (num_vertices > 0) {
+      uploader->upload(source->get(), vertices.data(), sizeof(Vertex) * num_vertices);
+    }
+
+    VkDeviceSize vertex_size = packed ? sizeof(PackedVertex) : sizeof(Vertex);
+    output_region = align(vertex_size * (std::max)(num_vertices, 1u));
+    output = mk_ptr<Buffer>(
+      device,
+      output_region * regions,
+      VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
+    );
+
+    params_region = align(sizeof(float));
+    params = mk_ptr<Buffer>(
+      device,
+      params_region * regions,
+      VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
+    );
+
+    for (u32 i = 0; i < regions; ++i) {
+      sets.push_back(pipeline->make_set({
+        { source->get(), 0, VK_WHOLE_SIZE },
+        { output->get(), output_region * i, output_region },
+        { params->get(), params_region * i, sizeof(float) },
+      }));
+    }
+  }
+
+  u32 size() const { return num_vertices; }
+
+  // the frame's previous submission must be done, its region is reused
+  void begin_frame(u32 frame_index, float angle) {
+    region = frame_index;
+    memcpy(params->mapped() + params_region * region, &angle, sizeof(float));
+  }
+
+  // what the current frame draws
+  VertexSpan span() {
+    return { output->get(), output_region * region, num_vertices };
+  }
+
+  // outside of the render pass, before it
+  void record(VkCommandBuffer buffer) {
+    Push push{ num_vertices };
+    pipeline->dispatch(buffer, sets[region], &push, ComputePipeline::groups(num_vertices, group_size));
+    ComputePipeline::barrier(buffer, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT);
+  }
+};
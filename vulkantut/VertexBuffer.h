@@ -2,6 +2,8 @@
 
 #include "LogicalDevice.h"
 #include "Vertex.h"
+#include "Buffer.h"
+#include "Uploader.h"
 
 #include "vulkan_include.h"
 #include "utils.h"
@@ -10,81 +12,68 @@
 using namespace std;
 using namespace utils;
 
+/***
+ * what a draw reads its vertices from: a VertexBuffer, or a per-frame RingBuffer allocation
+ */
+struct VertexSpan {
+  VkBuffer buffer;
+  VkDeviceSize offset;
+  u32 count;
+};
+
 
+// V is any VertexType (Vertex, PackedVertex, ...), the pipeline drawing it must be built w/
+// VertexLayout::of<V>()
 class VertexBuffer {
   ptr<LogicalDevice> device;
-  VkBuffer buffer;
-  VkDeviceMemory memory;
-  vector<Vertex> verts;
+  ptr<Buffer> buffer;
+  u32 count;
 
 public:
-  VkBuffer get() { return buffer; }
+  VkBuffer get() { return buffer->get(); }
+
+  u32 size() { return count; }
 
-  u32 size() { return verts.size(); }
+  VertexSpan span() { return { buffer->get(), 0, size() }; }
 
-  VertexBuffer(ptr<LogicalDevice> device, const vector<Vertex>& verts)
+  // HOST_VISIBLE | HOST_COHERENT memory, written directly by the CPU. On discrete GPUs the vertices
+  // are then read over PCIe on every draw, so this is only a good fit for data rewritten every frame
+  template<VertexType V>
+  VertexBuffer(ptr<LogicalDevice> device, const vector<V>& verts)
     : device(device)
-    , verts(verts)
+    , count(static_cast<u32>(verts.size()))
   {
-    VkBufferCreateInfo info = {};
-    info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-    info.size = sizeof(verts[0]) * verts.size();
-
-    // bitwise or for multiple usages
-    info.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
-
-    // buffers can be owned by a specific queue family or be shared between
-    // multiple at the same time
-    info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-
-    if (vkCreateBuffer(device->get(), &info, nullptr, &buffer) != VK_SUCCESS) {
-      throw runtime_error("failed to create vertex buffer");
-    }
-
-    VkMemoryRequirements memreqs;
-    vkGetBufferMemoryRequirements(device->get(), buffer, &memreqs);
-
-    VkMemoryAllocateInfo meminfo{};
-    meminfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    meminfo.allocationSize = memreqs.size;
-    meminfo.memoryTypeIndex = device->find_mem_type(
-      memreqs.memoryTypeBits, 
+    // a VkBuffer can't be empty, an empty mesh gets a 1 vertex buffer nothing reads
+    buffer = mk_ptr<Buffer>(
+      device,
+      sizeof(V) * (std::max)(verts.size(), size_t(1)),
+      VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
       VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |  // able to map and write to it from the CPU 
-      VK_MEMORY_PROPERTY_HOST_COHERENT_BIT   // copy immediately (see below) 
+      VK_MEMORY_PROPERTY_HOST_COHERENT_BIT   // copy immediately (see Buffer) 
     );
 
-    /*
-    *   Unfortunately the driver may not immediately copy the data into the
-    *   buffer memory, for example because of caching. It is also possible that
-    *   writes to the buffer are not visible in the mapped memory yet. There
-    *   are two ways to deal with that problem:
-    * 
-    * 1. Use a memory heap that is host coherent, indicated with VK_MEMORY_PROPERTY_HOST_COHERENT_BIT 
-    * 2. Call vkFlushMappedMemoryRanges after writing to the mapped memory, and
-    *    call vkInvalidateMappedMemoryRanges before reading from the mapped memory
-    * 
-    * Flushing memory ranges or using a coherent memory heap means that the
-    * driver will be aware of our writes to the buffer, but it doesn't mean
-    * that they are actually visible on the GPU yet. The transfer of data to
-    * the GPU is an operation that happens in the background and the
-    * specification simply tells us that it is guaranteed to be complete as of
-    * the next call to vkQueueSubmit.
-    */
-
-    if (vkAllocateMemory(device->get(), &meminfo, nullptr, &memory) != VK_SUCCESS) {
-      throw runtime_error("failed to allocate vertex buffer memory");
+    // host visible blocks are persistently mapped, no need to map / unmap
+    if (!verts.empty()) {
+      memcpy(buffer->mapped(), verts.data(), sizeof(V) * verts.size());
     }
-
-    vkBindBufferMemory(device->get(), buffer, memory, 0);
-
-    void* data;
-    vkMapMemory(device->get(), memory, 0, memreqs.size, 0, &data);
-    memcpy(data, verts.data(), memreqs.size);
-    vkUnmapMemory(device->get(), memory);
   }
 
-  ~VertexBuffer() {
-    vkDestroyBuffer(device->get(), buffer, nullptr);
-    vkFreeMemory(device->get(), memory, nullptr);
+  // DEVICE_LOCAL memory, copied in through the uploader's staging buffer.
+  // The copy is only queued, uploader->flush() before drawing w/ this buffer
+  template<VertexType V>
+  VertexBuffer(ptr<LogicalDevice> device, ptr<Uploader> uploader, const vector<V>& verts)
+    : device(device)
+    , count(static_cast<u32>(verts.size()))
+  {
+    buffer = mk_ptr<Buffer>(
+      device,
+      sizeof(V) * (std::max)(verts.size(), size_t(1)),
+      VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
+    );
+
+    if (!verts.empty()) {
+      uploader->upload(buffer->get(), verts.data(), sizeof(V) * verts.size());
+    }
   }
 };
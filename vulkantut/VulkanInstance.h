@@ -43,7 +43,7 @@ private:
     app_info.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
     app_info.pEngineName = "No Engine";
     app_info.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-    app_info.apiVersion = VK_API_VERSION_1_0;
+    app_info.apiVersion = VK_API_VERSION_1_2; // timeline semaphores, if the device has 1.2 too, see PhysDevice
     return app_info;
   }
 
@@ -79,14 +79,16 @@ public:
   }
 
 public:
-  VulkanInstance(bool debug = false) {
+  // headless: no window system, so the GLFW (WSI) extensions are not requested. This lets us run
+  // on machines w/o a display, e.g. CI boxes w/ a software driver like lavapipe
+  VulkanInstance(bool debug = false, bool headless = false) {
     VkInstanceCreateInfo instance_info{};
     instance_info.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
 
     auto app_info = mk_app_info();
     instance_info.pApplicationInfo = &app_info;
 
-    vector<const char*> extensions = glfw_required_extensions();
+    vector<const char*> extensions = headless ? vector<const char*>{} : glfw_required_extensions();
 
     if (debug) {
       // validation layers
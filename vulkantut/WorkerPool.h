@@ -0,0 +1,114 @@
+#pragma once
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "utils.h"
+
+using namespace std;
+using namespace utils;
+
+/***
+ * fork / join over a fixed set of threads: run(fn) calls fn(i) once on each worker i and returns
+ * when they're all done. Meant to be called every frame, so it doesn't allocate (fn is passed by
+ * pointer, not wrapped in a std::function) and the threads are kept around between runs.
+ *
+ * an exception thrown by fn on a worker is rethrown by run() on the calling thread
+ */
+class WorkerPool {
+  vector<thread> threads;
+
+  mutex pool_mutex;
+  condition_variable work_cv;
+  condition_variable done_cv;
+  uint64_t generation = 0; // bumped by every run(), workers wait for it to change
+  u32 remaining = 0; // workers not done w/ the current run
+  bool stopping = false;
+
+  void (*job)(void*, u32) = nullptr;
+  void* job_ctx = nullptr;
+  exception_ptr error;
+
+  void work(u32 index) {
+    uint64_t seen = 0;
+
+    while (true) {
+      void (*fn)(void*, u32);
+      void* ctx;
+      {
+        unique_lock lock(pool_mutex);
+        work_cv.wait(lock, [&]() { return stopping || generation != seen; });
+        if (stopping) {
+          return;
+        }
+
+        seen = generation;
+        fn = job;
+        ctx = job_ctx;
+      }
+
+      try {
+        fn(ctx, index);
+      } catch (...) {
+        lock_guard lock(pool_mutex);
+        if (!error) {
+          error = current_exception();
+        }
+      }
+
+      lock_guard lock(pool_mutex);
+      if (--remaining == 0) {
+        done_cv.notify_one();
+      }
+    }
+  }
+
+public:
+  WorkerPool(u32 num_threads) {
+    for (u32 i = 0; i < num_threads; ++i) {
+      threads.emplace_back(&WorkerPool::work, this, i);
+    }
+  }
+
+  ~WorkerPool() {
+    {
+      lock_guard lock(pool_mutex);
+      stopping = true;
+    }
+    work_cv.notify_all();
+
+    for (auto& t : threads) {
+      t.join();
+    }
+  }
+
+  u32 size() const { return static_cast<u32>(threads.size()); }
+
+  // fn(u32 worker_index) must be safe to call from size() threads at once
+  template<typename F>
+  void run(F& fn) {
+    if (threads.empty()) {
+      return;
+    }
+
+    {
+      lock_guard lock(pool_mutex);
+      job = [](void* ctx, u32 index) { (*static_cast<F*>(ctx))(index); };
+      job_ctx = &fn;
+      remaining = size();
+      error = nullptr;
+      ++generation;
+    }
+    work_cv.notify_all();
+
+    unique_lock lock(pool_mutex);
+    done_cv.wait(lock, [this]() { return remaining == 0; });
+
+    if (error) {
+      exception_ptr res = error;
+      error = nullptr;
+      rethrow_exception(res);
+    }
+  }
+};
@@ -7,14 +7,50 @@
 #include "Swapchain.h"
 #include "Framebuffer.h"
 #include "GraphicsPipeline.h"
+#include "PipelineCompiler.h"
+#include "PipelineRegistry.h"
 #include "Frame.h"
+#include "WorkerPool.h"
+#include "FrameLimiter.h"
 #include "Command.h"
 #include "ImageView.h"
+#include "Image.h"
+#include "RingBuffer.h"
+#include "IndexBuffer.h"
+#include "InstanceBuffer.h"
+#include "GpuCulling.h"
+#include "VertexAnimator.h"
+#include "Mesh.h"
 
 using namespace std;
 using namespace utils;
 
 
+// only in builds w/ ALLOC_AUDIT defined (the Debug configurations are), it replaces the global
+// operator new / delete. Every operator new on the calling thread bumps this, see
+// BetterTriangle::alloc_audit().
+// thread_local so that e.g. the pipeline compiler's workers don't count; neither do the record
+// workers (--record-threads), their allocations aren't audited
+#ifdef ALLOC_AUDIT
+thread_local uint64_t thread_allocations = 0;
+
+void* operator new(size_t size) {
+  ++thread_allocations;
+  if (void* p = malloc(size ? size : 1)) {
+    return p;
+  }
+  throw bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+  free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+  free(p);
+}
+#endif
+
 
 vector<ptr<ImageView>> imageviews(ptr<LogicalDevice> device, ptr<Swapchain> swapchain) {
   vector<VkImage> images;
@@ -44,24 +80,143 @@ vector<ptr<Framebuffer>> framebuffers(ptr<LogicalDevice> device, ptr<Swapchain>
 }
 
 
+// headless counterpart of the above, one framebuffer per device-owned image
+vector<ptr<Framebuffer>> framebuffers(ptr<LogicalDevice> device, const vector<ptr<Image>>& images, ptr<RenderPass> renderpass) {
+  return map(
+    images,
+    [=](auto& image) {
+      return mk_ptr<Framebuffer>(device, renderpass, mk_ptr<ImageView>(device, image), image->extent);
+    }
+  );
+}
+
+
+// vertex format the scene is stored in, see Vertex.h. Build w/ PACKED_VERTICES defined for the
+// 8 byte PackedVertex instead of the 20 byte Vertex
+#ifdef PACKED_VERTICES
+using SceneVertex = PackedVertex;
+#else
+using SceneVertex = Vertex;
+#endif
+
+
+// grid_size x grid_size quads covering the whole viewport, as a raw triangle list
+vector<Vertex> grid_triangles(u32 grid_size) {
+  vector<Vertex> soup;
+  soup.reserve(grid_size * grid_size * 6);
+
+  auto vertex = [grid_size](u32 x, u32 y) {
+    float u = x / float(grid_size);
+    float v = y / float(grid_size);
+    return Vertex{ { u * 2.0f - 1.0f, v * 2.0f - 1.0f }, { u, v, 1.0f - u } };
+  };
+
+  for (u32 y = 0; y < grid_size; ++y) {
+    for (u32 x = 0; x < grid_size; ++x) {
+      soup.insert(soup.end(), { vertex(x, y), vertex(x + 1, y), vertex(x, y + 1) });
+      soup.insert(soup.end(), { vertex(x + 1, y), vertex(x + 1, y + 1), vertex(x, y + 1) });
+    }
+  }
+
+  return soup;
+}
+
+
+// CPU only: how many vertices the GPU would shade for a grid mesh, as a raw triangle list,
+// deduplicated + indexed, and after reordering the indices for the post-transform cache
+void mesh_bench(u32 grid_size = 256, u32 cache_size = 16) {
+  vector<Vertex> soup = grid_triangles(grid_size);
+
+  auto start = chrono::steady_clock::now();
+  Mesh indexed = Mesh::build(soup, false);
+  auto dedup_done = chrono::steady_clock::now();
+  Mesh optimized = Mesh::build(soup, true);
+  auto optimize_done = chrono::steady_clock::now();
+
+  u32 triangles = static_cast<u32>(soup.size() / 3);
+  auto report = [triangles](const char* name, u32 shaded) {
+    cout << format(
+      "[mesh-bench] {:<24} {:>8} vertices shaded, {:.3f} per triangle\n",
+      name,
+      shaded,
+      shaded / double(triangles)
+    );
+  };
+
+  cout << format(
+    "[mesh-bench] {}x{} grid, {} triangles, {} unique vertices, post-transform cache {}\n",
+    grid_size,
+    grid_size,
+    triangles,
+    indexed.vertices.size(),
+    cache_size
+  );
+  report("triangle list", static_cast<u32>(soup.size()));
+  report("indexed", shaded_vertices(indexed.indices, cache_size));
+  report("indexed + reordered", shaded_vertices(optimized.indices, cache_size));
+  cout << format(
+    "[mesh-bench] dedup {:.2f} ms, dedup + reorder {:.2f} ms\n",
+    chrono::duration<double, milli>(dedup_done - start).count(),
+    chrono::duration<double, milli>(optimize_done - dedup_done).count()
+  );
+}
+
+
 class BetterTriangle {
 public:
-  ptr<Window> window;
+  const bool headless;
+
+  ptr<Window> window; // window, surface & swapchain are null when headless
   ptr<VulkanInstance> instance;
   ptr<Surface> surface;
   ptr<PhysDevice> physical_device;
   ptr<LogicalDevice> device;
   ptr<Swapchain> swapchain;
   vector<ptr<Framebuffer>> framebuffers;
+  ptr<CommandCache> command_cache; // a pre-recorded command buffer per framebuffer
+  vector<ptr<Image>> offscreen_images; // headless render targets, one per frame in flight
+  VkExtent2D offscreen_extent;
   ptr<RenderPass> renderpass;
-  ptr<Command> command;
-  ptr<GraphicsPipeline> pipeline;
+  VkFormat renderpass_format; // format renderpass (and so pipeline) was built for
+  ptr<GraphicsPipeline> pipeline; // null until the first one is compiled
+  VertexLayout vertex_layout = VertexLayout::of<SceneVertex>();
+  ptr<PipelineCompiler> compiler;
+  ptr<PipelineRegistry> pipelines; // every pipeline goes through this, built once on the compiler
+  PipelineHandle pending_pipeline; // replaces pipeline once it's compiled
+  SpecConstants frag_constants; // see specialize()
   vector<ptr<Frame>> frames;
   vector<ptr<Frame>>::iterator curr_frame;
+  ptr<GpuTimings> gpu_timings; // filled by the frames, a frame late
+  RollingStats latency; // ms from recording a frame until the CPU sees it's done, see Frame::retire
+  RollingStats record_time; // CPU ms spent recording a frame's commands
+  RollingStats frame_time; // ms between consecutive frames, its stddev is how even the pacing is
+  optional<chrono::steady_clock::time_point> last_frame_at;
+  ptr<WorkerPool> record_workers; // record the draws into secondary buffers, see set_record_threads()
 
+  ptr<Uploader> uploader;
+  vector<Vertex> triangle;
   ptr<VertexBuffer> vertices;
+  ptr<IndexBuffer> indices;
+  ptr<InstanceBuffer> instances; // null: a single copy, not instanced. See set_instances()
+  ptr<GpuCulling> culling; // the instances are culled & drawn by the GPU, see set_gpu_driven()
+  ptr<VertexAnimator> animator; // the triangle is rotated by a compute pass, see set_gpu_animation()
 
-  const u32 max_frames_inflight = 2;
+  // per-frame streamed data, one region per frame in flight
+  ptr<RingBuffer> ring;
+  VkDeviceSize ring_size = 64 * 1024; // per frame in flight
+  bool stream = false; // re-upload the (rotated) triangle through the ring every frame
+  RollingStats animate_time; // CPU ms spent rotating the streamed triangle
+  bool static_scene = false; // replay the command_cache instead of recording every frame
+  u32 draw_calls = 1; // the scene is drawn this many times, to bench draw call overhead
+  u32 frame_count = 0;
+  u32 skipped_frames = 0; // no pipeline to draw w/ yet
+
+  static constexpr u32 max_frames_inflight = 4;
+  u32 frames_inflight; // 1 - max_frames_inflight, see set_frames_inflight()
+
+  PresentPolicy present_policy = PresentPolicy::low_latency; // see set_present_policy()
+  ptr<FrameLimiter> limiter; // see set_fps_limit()
+  bool pace_presents = false; // wait for the last present to be displayed before starting a frame
 
   static ptr<PhysDevice> find_physical_device(ptr<VulkanInstance> instance, ptr<Surface> surface) {
     auto suitable_physical_devices = instance->find_devices([surface](const PhysDevice& device) {
@@ -87,73 +242,271 @@ public:
     return mk_ptr<PhysDevice>(suitable_physical_devices.back().get());
   }
 
+  // no surface to present to, so all we need is something that can draw
+  static ptr<PhysDevice> find_headless_physical_device(ptr<VulkanInstance> instance) {
+    auto suitable_physical_devices = instance->find_devices([](const PhysDevice& device) {
+      return !device.graphics_queue_families().empty();
+    });
+
+    if (suitable_physical_devices.empty()) {
+      throw runtime_error("failed to find suitable GPU");
+    }
+
+    cout << format(
+      "suitable physical devices (headless): {}\n",
+      to_str(map(suitable_physical_devices, [](auto& d) { return d.name(); }), "\n\t", ",\n\t")
+    );
+
+    return mk_ptr<PhysDevice>(suitable_physical_devices.back().get());
+  }
+
 private:
+  PipelineDesc pipeline_desc() {
+    if (instances) {
+      return PipelineDesc{
+        .renderpass = renderpass,
+        .vertex_layout = vertex_layout.instanced<Instance>(),
+        .vert_shader = "shaders/instanced_vert.spv",
+        .frag_constants = frag_constants
+      };
+    }
+
+    return PipelineDesc{
+      .renderpass = renderpass,
+      .vertex_layout = vertex_layout,
+      .frag_constants = frag_constants
+    };
+  }
+
+  // k distinct variants of the scene pipeline, differing only in fixed function state
+  vector<PipelineDesc> pipeline_variants(u32 k) {
+    const VkPrimitiveTopology topologies[] = {
+      VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
+      VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP,
+      VK_PRIMITIVE_TOPOLOGY_LINE_LIST,
+      VK_PRIMITIVE_TOPOLOGY_LINE_STRIP
+    };
+    const VkCullModeFlags cull_modes[] = { VK_CULL_MODE_NONE, VK_CULL_MODE_FRONT_BIT, VK_CULL_MODE_BACK_BIT };
+    const VkFrontFace front_faces[] = { VK_FRONT_FACE_CLOCKWISE, VK_FRONT_FACE_COUNTER_CLOCKWISE };
+
+    size_t num_variants = size(topologies) * size(cull_modes) * size(front_faces) * 2; // * blend
+    if (k > num_variants) {
+      throw runtime_error(format("only {} distinct pipeline variants, asked for {}", num_variants, k));
+    }
+
+    vector<PipelineDesc> res;
+    for (auto topology : topologies) {
+      for (auto cull_mode : cull_modes) {
+        for (auto front_face : front_faces) {
+          for (bool blend : { false, true }) {
+            if (res.size() == k) {
+              return res;
+            }
+
+            PipelineDesc desc = pipeline_desc();
+            desc.topology = topology;
+            desc.cull_mode = cull_mode;
+            desc.front_face = front_face;
+            desc.blend = blend;
+            res.push_back(desc);
+          }
+        }
+      }
+    }
+
+    return res;
+  }
+
+  // blocks until the pending pipeline (if any) is compiled and swaps it in
+  void wait_pipeline() {
+    if (pending_pipeline.valid()) {
+      pipeline = pending_pipeline.get();
+      pending_pipeline = {};
+    }
+  }
+
   void init_swapchain() {
     cout << "... initializing swap chain\n";
 
     window->wait_minimized(); 
-    device->wait_idle(); // this prevents destroying framebuffers that are being used...
-
-    // not sure which of these fuckers causes it, but without fully destroying these before
-    // recreating them, I get heap corruption (specifically happened when destroying swapchain,
-    // so maybe we can't have multiple swapchains at the same time or something?)
-    swapchain = nullptr;
-    renderpass = nullptr;
-    framebuffers.clear();
-    pipeline = nullptr;
-
-    swapchain = mk_ptr<Swapchain>(device, surface);
-    renderpass = mk_ptr<RenderPass>(device, swapchain->format);
+
+    // no wait_idle: the new swapchain is created from the old one, and whatever the frames in
+    // flight might still be using is only destroyed once they're done (see DeletionQueue)
+    swapchain = mk_ptr<Swapchain>(device, surface, present_policy, swapchain.get());
+
+    // viewport / scissor are dynamic, so the render pass & pipeline only depend on the format, 
+    // which doesn't change on resize. Only rebuild them if it did. The old pipeline doesn't fit the
+    // new render pass, so frames are skipped until the new one is compiled
+    if (!renderpass || swapchain->format != renderpass_format) {
+      pipeline = nullptr;
+      if (renderpass) {
+        pipelines->release(renderpass_format);
+      }
+      renderpass = nullptr;
+
+      renderpass_format = swapchain->format;
+      renderpass = mk_ptr<RenderPass>(device, swapchain->format);
+      pending_pipeline = pipelines->get(pipeline_desc());
+    }
+
     framebuffers = ::framebuffers(device, swapchain, renderpass);
-    pipeline = mk_ptr<GraphicsPipeline>(device, swapchain, renderpass);
+    init_command_cache();
   }
 
-public:
-  BetterTriangle(uint32_t height, uint32_t width) {
-    window = mk_ptr<Window>(height, width);
-    instance = mk_ptr<VulkanInstance>(true);
-    surface = mk_ptr<Surface>(instance, window);
-
-    physical_device = find_physical_device(instance, surface);
-
-    QueueFamily graphics_fam = physical_device->graphics_queue_families().back();
-    QueueFamily present_fam = physical_device->present_queue_families(surface->get()).back();
-    device = mk_ptr<LogicalDevice>(
-      physical_device,
-      graphics_fam,
-      present_fam
+  void init_command_cache() {
+    command_cache = mk_ptr<CommandCache>(
+      device,
+      device->graphics_qfam,
+      static_cast<u32>(framebuffers.size())
     );
+  }
 
-    command = mk_ptr<Command>(device, graphics_fam.index, max_frames_inflight);
-    init_swapchain();
+  // one render target per frame in flight, so rebuilt whenever their number changes
+  void init_offscreen() {
+    cout << "... initializing offscreen render targets\n";
 
-    for (u32 i = 0; i < max_frames_inflight; ++i) {
-      frames.push_back(mk_ptr<Frame>(device));
+    // images are left in TRANSFER_SRC so they can be copied out / read back if needed
+    const VkFormat format = VK_FORMAT_R8G8B8A8_UNORM;
+    if (!renderpass) {
+      renderpass = mk_ptr<RenderPass>(device, format, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+      pending_pipeline = pipelines->get(pipeline_desc());
     }
 
+    offscreen_images.clear();
+    for (u32 i = 0; i < frames_inflight; ++i) {
+      offscreen_images.push_back(mk_ptr<Image>(
+        device,
+        format,
+        offscreen_extent,
+        VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT
+      ));
+    }
+
+    framebuffers = ::framebuffers(device, offscreen_images, renderpass);
+    init_command_cache();
+  }
+
+  // everything there's one of per frame in flight. The device must be idle
+  void init_frames() {
+    frames.clear();
+    for (u32 i = 0; i < frames_inflight; ++i) {
+      frames.push_back(mk_ptr<Frame>(device, device->graphics_qfam, gpu_timings));
+      frames.back()->workers = record_workers.get();
+    }
     curr_frame = frames.begin();
 
-    vertices = mk_ptr<VertexBuffer>(device, vector<Vertex> {
-      { {0.0f, -0.5f}, { 1.0f, 0.0f, 0.0f }},
-      { {0.5f, 0.5f}, {0.0f, 1.0f, 0.0f} },
-      { {-0.5f, 0.5f}, {0.0f, 0.0f, 1.0f} }
-        //{ {0.0f, -0.5f}, { 1.0f, 1.0f, 1.0f }},
-        //{ {0.5f, 0.5f}, {0.0f, 1.0f, 0.0f} },
-        //{ {-0.5f, 0.5f}, {0.0f, 0.0f, 1.0f} }
-    });
+    ring = mk_ptr<RingBuffer>(device, ring_size, frames_inflight);
+
+    if (headless) {
+      init_offscreen();
+    } else {
+      // the fences in there belonged to the old frames. Timeline values don't, they stay valid
+      fill(swapchain->images_inflight.begin(), swapchain->images_inflight.end(), VK_NULL_HANDLE);
+    }
   }
 
-  void run() {
-    while (!window->should_close()) {
+  // writes the triangle, rotated a bit more every frame, straight into this frame's ring region
+  VertexSpan streamed_vertices() {
+    auto start = chrono::steady_clock::now();
+    auto alloc = ring->alloc(sizeof(SceneVertex) * triangle.size());
+    auto verts = reinterpret_cast<SceneVertex*>(alloc.data);
+
+    float angle = frame_count * 0.01f;
+    float c = cos(angle);
+    float s = sin(angle);
+    for (size_t i = 0; i < triangle.size(); ++i) {
+      auto& pos = triangle[i].pos;
+      verts[i] = SceneVertex::from({ { pos.x * c - pos.y * s, pos.x * s + pos.y * c }, triangle[i].color });
+    }
+
+    animate_time.add(chrono::duration<double, milli>(chrono::steady_clock::now() - start).count());
+    return { alloc.buffer, alloc.offset, static_cast<u32>(triangle.size()) };
+  }
+
+  // same rotation, done by the animator's compute pass into this frame's region of its buffer
+  VertexSpan animated_vertices(u32 frame_index) {
+    animator->begin_frame(frame_index, frame_count * 0.01f);
+    return animator->span();
+  }
+
+  // records & submits the current frame, then moves on to the next one. Returns false if the frame
+  // was skipped because the pipeline is still being compiled
+  bool draw_frame() {
+    if (auto compiled = pending_pipeline.try_get()) {
+      // no wait_idle, if the old one goes away the frames in flight still using it are waited for
+      // (see DeletionQueue). The new one could get its handle then, so the cached buffers must go
+      if (pipeline && pipeline != compiled) {
+        command_cache->mark_dirty();
+      }
+      pipeline = compiled;
+      pending_pipeline = {};
+    }
+
+    if (!pipeline) {
+      if (!headless) {
+        glfwPollEvents(); // keep the window responsive meanwhile
+      }
+      ++skipped_frames;
+      this_thread::yield();
+      return false;
+    }
+
+    if (limiter) {
+      limiter->wait();
+    }
+    if (pace_presents && !headless) {
+      swapchain->wait_presented();
+    }
+
+    u32 frame_index = static_cast<u32>(curr_frame - frames.begin());
+
+    // the frame's previous submission must be done before its ring region is reused
+    if (auto ms = (*curr_frame)->retire()) {
+      latency.add(*ms);
+    }
+    ring->begin_frame(frame_index);
+
+    Geometry geometry;
+    if (animator) {
+      geometry = { animated_vertices(frame_index) };
+      geometry.animator = animator.get();
+    } else if (stream) {
+      geometry = { streamed_vertices() };
+    } else {
+      geometry = { vertices->span(), indices->span() };
+    }
+    geometry.draws = draw_calls;
+    if (instances) {
+      geometry.instances = instances->span();
+    }
+    if (culling && !stream && !animator) {
+      geometry.culling = culling.get();
+    }
+
+    // streamed vertices are fine too: the cached buffers are re-recorded when the ring region
+    // they point to isn't this frame's
+    CommandCache* cache = static_scene ? command_cache.get() : nullptr;
+
+    if (headless) {
+      (*curr_frame)->draw_offscreen(
+        *renderpass,
+        *framebuffers[frame_index],
+        frame_index,
+        offscreen_extent,
+        *pipeline,
+        geometry,
+        cache
+      );
+    } else {
       glfwPollEvents();
 
       VkResult draw_result = (*curr_frame)->draw(
-        renderpass,
-        swapchain,
-        pipeline,
+        *renderpass,
+        *swapchain,
+        *pipeline,
         framebuffers,
-        command->get_buffer(curr_frame - frames.begin()),
-        vertices
+        geometry,
+        cache
       );
 
       if (draw_result == VK_ERROR_OUT_OF_DATE_KHR ||
@@ -164,21 +517,816 @@ public:
       } else if (draw_result != VK_SUCCESS) {
         throw runtime_error("failed to present swap chain image");
       }
+    }
+
+    record_time.add((*curr_frame)->record_ms);
 
-      if (++curr_frame == frames.end()) {
-        curr_frame = frames.begin();
+    auto now = chrono::steady_clock::now();
+    if (last_frame_at) {
+      frame_time.add(chrono::duration<double, milli>(now - *last_frame_at).count());
+    }
+    last_frame_at = now;
+
+    if (++curr_frame == frames.end()) {
+      curr_frame = frames.begin();
+    }
+    ++frame_count;
+    return true;
+  }
+
+public:
+  BetterTriangle(uint32_t height, uint32_t width, bool headless = false, u32 frames_inflight = 2)
+    : headless(headless)
+    , frames_inflight(frames_inflight)
+  {
+    if (frames_inflight < 1 || frames_inflight > max_frames_inflight) {
+      throw runtime_error(format("frames in flight must be 1 - {}", max_frames_inflight));
+    }
+
+    if (headless) {
+      // no validation layers either, CI boxes w/ a software driver usually don't have the SDK installed
+      instance = mk_ptr<VulkanInstance>(false, true);
+      physical_device = find_headless_physical_device(instance);
+
+      QueueFamily graphics_fam = physical_device->graphics_queue_families().back();
+      device = mk_ptr<LogicalDevice>(
+        physical_device,
+        graphics_fam,
+        graphics_fam, // nothing is presented, present_q is just an alias of graphics_q
+        vector<const char*>{}
+      );
+
+      compiler = mk_ptr<PipelineCompiler>(device);
+      pipelines = mk_ptr<PipelineRegistry>(device, compiler);
+      offscreen_extent = { height, width };
+    } else {
+      window = mk_ptr<Window>(height, width);
+      instance = mk_ptr<VulkanInstance>(true);
+      surface = mk_ptr<Surface>(instance, window);
+
+      physical_device = find_physical_device(instance, surface);
+
+      QueueFamily graphics_fam = physical_device->graphics_queue_families().back();
+      QueueFamily present_fam = physical_device->present_queue_families(surface->get()).back();
+
+      // present wait is cheap to have on, whether it's used is up to pace_presents
+      vector<const char*> device_extensions = { VK_KHR_SWAPCHAIN_EXTENSION_NAME };
+      if (physical_device->supports_present_wait()) {
+        device_extensions.push_back(VK_KHR_PRESENT_ID_EXTENSION_NAME);
+        device_extensions.push_back(VK_KHR_PRESENT_WAIT_EXTENSION_NAME);
       }
+
+      device = mk_ptr<LogicalDevice>(
+        physical_device,
+        graphics_fam,
+        present_fam,
+        device_extensions
+      );
+
+      compiler = mk_ptr<PipelineCompiler>(device);
+      pipelines = mk_ptr<PipelineRegistry>(device, compiler);
+      init_swapchain();
+    }
+
+    gpu_timings = mk_ptr<GpuTimings>();
+    init_frames();
+
+    uploader = mk_ptr<Uploader>(device);
+
+    triangle = {
+      { {0.0f, -0.5f}, { 1.0f, 0.0f, 0.0f }},
+      { {0.5f, 0.5f}, {0.0f, 1.0f, 0.0f} },
+      { {-0.5f, 0.5f}, {0.0f, 0.0f, 1.0f} }
+        //{ {0.0f, -0.5f}, { 1.0f, 1.0f, 1.0f }},
+        //{ {0.5f, 0.5f}, {0.0f, 1.0f, 0.0f} },
+        //{ {-0.5f, 0.5f}, {0.0f, 0.0f, 1.0f} }
+    };
+    auto mesh = MeshT<SceneVertex>::build(map(triangle, SceneVertex::from));
+    vertices = mk_ptr<VertexBuffer>(device, uploader, mesh.vertices);
+    indices = mk_ptr<IndexBuffer>(device, uploader, mesh.indices);
+
+    uploader->flush();
+  }
+
+  // more frames in flight == more CPU / GPU overlap (throughput), but frames wait longer in the
+  // queue before they're done (latency)
+  void set_frames_inflight(u32 n) {
+    if (n < 1 || n > max_frames_inflight) {
+      throw runtime_error(format("frames in flight must be 1 - {}", max_frames_inflight));
     }
 
     device->wait_idle();
+    frames_inflight = n;
+    init_frames();
+  }
+
+  // n > 0: the draws are split over n worker threads, each recording a secondary command buffer
+  // from its own pool, which the frame's primary buffer then executes. 0: recorded inline
+  void set_record_threads(u32 n) {
+    record_workers = n > 0 ? mk_ptr<WorkerPool>(n) : nullptr;
+    for (auto& frame : frames) {
+      frame->workers = record_workers.get();
+    }
+  }
+
+  // n copies of the scene on a grid, all drawn by one instanced draw call (unless draw_calls splits
+  // them). 0: back to a single copy. Switches pipelines, so frames are skipped until it's compiled
+  void set_instances(u32 n) {
+    if (n == 0) {
+      instances = nullptr;
+    } else {
+      u32 side = static_cast<u32>(ceil(sqrt(static_cast<double>(n))));
+      float cell = 2.0f / side;
+
+      vector<Instance> grid(n);
+      for (u32 i = 0; i < n; ++i) {
+        u32 x = i % side;
+        u32 y = i / side;
+        grid[i] = {
+          { -1.0f + cell * (x + 0.5f), -1.0f + cell * (y + 0.5f) },
+          cell * 0.5f,
+          { 0.5f + 0.5f * x / side, 0.5f + 0.5f * y / side, 1.0f }
+        };
+      }
+
+      // the old buffer is destroyed once the frames in flight are done w/ it, see DeletionQueue
+      instances = mk_ptr<InstanceBuffer>(device, uploader, grid);
+      uploader->flush();
+    }
+
+    command_cache->mark_dirty(); // the new buffer might reuse the old handle
+    pending_pipeline = pipelines->get(pipeline_desc());
+    set_gpu_driven(culling != nullptr);
+  }
+
+  // instances culled by a compute pass and drawn w/ a single indirect draw, instead of the CPU
+  // recording one draw per draw_calls. Needs set_instances()
+  void set_gpu_driven(bool on) {
+    culling = on && instances
+      ? mk_ptr<GpuCulling>(device, instances->span())
+      : nullptr;
+    command_cache->mark_dirty(); // the new one might get the address of the old one
+  }
+
+  // the triangle rotated every frame like w/ stream, but by a compute shader writing the vertex
+  // buffer that's drawn. Takes precedence over stream
+  void set_gpu_animation(bool on) {
+    // regions for as many frames in flight as there can be, so set_frames_inflight() needn't care
+    animator = on
+      ? mk_ptr<VertexAnimator>(device, uploader, triangle, max_frames_inflight, is_same_v<SceneVertex, PackedVertex>)
+      : nullptr;
+    uploader->flush();
+    command_cache->mark_dirty(); // the new one might get the handles of the old one
+  }
+
+  // only matters when there's a window, headless frames aren't presented
+  void set_present_policy(PresentPolicy policy) {
+    present_policy = policy;
+    if (!headless) {
+      init_swapchain();
+    }
+  }
+
+  // 0: no limit
+  void set_fps_limit(double fps) {
+    limiter = fps > 0.0 ? mk_ptr<FrameLimiter>(fps) : nullptr;
+  }
+
+  // recompiles the scene pipeline w/ other specialization constants for shader.frag, e.g.
+  // SPEC_LIGHT_COUNT. The current pipeline keeps being used until the new one is ready
+  void specialize(const SpecConstants& constants) {
+    frag_constants = constants;
+    pending_pipeline = pipelines->get(pipeline_desc());
+  }
+
+  // swaps the scene for a grid_size x grid_size grid stored as V, then benches it
+  template<VertexType V>
+  void bench_format(const char* name, const vector<Vertex>& grid, u32 num_frames) {
+    // the old buffers are still used by the frames in flight, they're destroyed once those are done
+    auto mesh = MeshT<V>::build(map(grid, [](const Vertex& v) { return V::from(v); }));
+    vertices = mk_ptr<VertexBuffer>(device, uploader, mesh.vertices);
+    indices = mk_ptr<IndexBuffer>(device, uploader, mesh.indices);
+    uploader->flush();
+    command_cache->mark_dirty(); // new buffers might reuse the old handles
+
+    vertex_layout = VertexLayout::of<V>();
+    wait_pipeline();
+    pipeline = pipelines->get(pipeline_desc()).get();
+
+    cout << format(
+      "[format-bench] {}: {} bytes/vertex, {} vertices, {:.2f} MB of vertex data\n",
+      name,
+      sizeof(V),
+      mesh.vertices.size(),
+      sizeof(V) * mesh.vertices.size() / (1024.0 * 1024.0)
+    );
+
+    gpu_timings->clear();
+    bench(num_frames);
+  }
+
+  // same mesh, full precision vs packed vertices. Compare the draw GPU times
+  void format_bench(u32 num_frames, u32 grid_size = 512) {
+    // the scene is restored after, so the bench can run in the middle of a session
+    wait_pipeline();
+    bool streamed = stream;
+    auto animated = animator;
+    auto scene_layout = vertex_layout;
+    auto scene_pipeline = pipeline;
+    auto scene_vertices = vertices;
+    auto scene_indices = indices;
+    stream = false;
+    animator = nullptr;
+
+    auto grid = grid_triangles(grid_size);
+    bench_format<Vertex>("Vertex", grid, num_frames);
+    bench_format<PackedVertex>("PackedVertex", grid, num_frames);
+
+    stream = streamed;
+    animator = animated;
+    vertex_layout = scene_layout;
+    pipeline = scene_pipeline;
+    vertices = scene_vertices;
+    indices = scene_indices;
+    command_cache->mark_dirty();
+  }
+
+  // the same pipeline, compiled from scratch vs w/ the (by now warm) pipeline cache.
+  // Note some drivers keep their own shader cache on disk, making "cold" not entirely cold
+  void pipeline_cache_bench(u32 iterations = 20) {
+    RollingStats cold;
+    RollingStats warm;
+
+    for (u32 i = 0; i < iterations; ++i) {
+      cold.add(GraphicsPipeline(device, pipeline_desc(), false).create_ms);
+      warm.add(GraphicsPipeline(device, pipeline_desc(), true).create_ms);
+    }
+
+    cout << format(
+      "[pipeline-cache-bench] cold compile: mean {:.3f} ms, p50 {:.3f} ms\n"
+      "[pipeline-cache-bench] cache hit:    mean {:.3f} ms, p50 {:.3f} ms\n",
+      cold.mean(),
+      cold.p50(),
+      warm.mean(),
+      warm.p50()
+    );
+    cout << "[pipeline-cache-bench] " << device->pipeline_cache->to_str() << "\n";
+  }
+
+  // k pipeline variants compiled one after the other on this thread vs on the compiler's workers.
+  // Both w/o the cache, otherwise the second run would only measure cache hits
+  void pipeline_compile_bench(u32 k = 48) {
+    wait_pipeline();
+    auto variants = pipeline_variants(k);
+
+    auto start = chrono::steady_clock::now();
+    for (auto& desc : variants) {
+      GraphicsPipeline(device, desc, false);
+    }
+    double serial_ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+    start = chrono::steady_clock::now();
+    auto handles = map(variants, [this](const PipelineDesc& desc) { return compiler->submit(desc, false); });
+    for (auto& handle : handles) {
+      handle.get();
+    }
+    double parallel_ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+    cout << format(
+      "[pipeline-compile-bench] {} variants, serial {:.2f} ms, parallel ({} threads) {:.2f} ms, {:.2f}x\n",
+      variants.size(),
+      serial_ms,
+      compiler->threads(),
+      parallel_ms,
+      serial_ms / parallel_ms
+    );
+  }
+
+  // draws warmup frames, then num_frames more, each of which must not allocate on this thread:
+  // run() / bench() should be allocation free once the pipeline is there and every frame went
+  // around once. Returns false (and says where) if any of them did, or if the build can't count.
+  // W/ --record-threads only the main thread's part of the frame is audited, not the workers'
+  bool alloc_audit(u32 num_frames, u32 warmup = 100) {
+#ifndef ALLOC_AUDIT
+    cout << "[alloc-audit] this build can't count allocations, it needs ALLOC_AUDIT defined (Debug builds)\n";
+    return false;
+#else
+    wait_pipeline();
+    for (u32 i = 0; i < warmup; ++i) {
+      draw_frame();
+    }
+
+    u32 failed = 0;
+    uint64_t total = 0;
+    uint64_t first_frame = 0;
+    uint64_t first_count = 0;
+
+    for (u32 i = 0; i < num_frames; ++i) {
+      uint64_t before = thread_allocations;
+      draw_frame();
+      uint64_t count = thread_allocations - before;
+
+      if (count > 0) {
+        if (failed == 0) {
+          first_frame = i;
+          first_count = count;
+        }
+        failed += 1;
+        total += count;
+      }
+    }
+
+    // like run() / bench(), the frames' submissions must be done before the frames go away
+    device->wait_idle();
+
+    if (failed > 0) {
+      cout << format(
+        "[alloc-audit] FAILED: {} of {} frames allocated, {} allocations total (first: frame {}, {} allocations)\n",
+        failed,
+        num_frames,
+        total,
+        first_frame,
+        first_count
+      );
+      return false;
+    }
+
+    cout << format(
+      "[alloc-audit] ok: {} frames after {} warmup frames, 0 allocations on the main thread{}\n",
+      num_frames,
+      warmup,
+      record_workers ? " (record workers not audited)" : ""
+    );
+    return true;
+#endif
+  }
+
+  void run() {
+    while (!window->should_close()) {
+      draw_frame();
+    }
+
+    device->wait_idle();
+  }
+
+  // draws num_frames as fast as possible and reports throughput. Works both headless and windowed,
+  // so that every perf change can be measured the same way
+  double bench(u32 num_frames) {
+    wait_pipeline(); // don't count the startup compile as skipped frames
+    latency.clear();
+    record_time.clear();
+    frame_time.clear();
+    animate_time.clear();
+    last_frame_at.reset();
+
+    auto start = chrono::steady_clock::now();
+
+    for (u32 i = 0; i < num_frames;) {
+      if (draw_frame()) {
+        ++i;
+      }
+    }
+
+    device->wait_idle(); // count the frames as done only once the GPU is done w/ them
+
+    double secs = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    cout << format(
+      "[bench] {} frames in {:.3f}s, {:.1f} frames/sec, {:.3f} ms/frame\n",
+      num_frames,
+      secs,
+      num_frames / secs,
+      secs * 1000.0 / num_frames
+    );
+    cout << format(
+      "[bench] latency ({} frames in flight): mean {:.3f} ms, p50 {:.3f} ms, p99 {:.3f} ms\n",
+      frames_inflight,
+      latency.mean(),
+      latency.p50(),
+      latency.p99()
+    );
+    cout << format(
+      "[bench] frame time ({}{}{}): mean {:.3f} ms, stddev {:.3f} ms, p99 {:.3f} ms\n",
+      headless ? "headless" : to_str(present_policy),
+      limiter ? format(", limited to {} fps", limiter->fps) : "",
+      pace_presents && device->present_wait ? ", paced by present wait" : "",
+      frame_time.mean(),
+      frame_time.stddev(),
+      frame_time.p99()
+    );
+    cout << format(
+      "[bench] recording {} draw calls on {} threads: mean {:.3f} ms, p99 {:.3f} ms\n",
+      draw_calls,
+      record_workers ? record_workers->size() : 0,
+      record_time.mean(),
+      record_time.p99()
+    );
+    cout << "[bench] " << gpu_timings->to_str();
+    cout << "[bench] " << device->allocator->stats().to_str() << "\n";
+    cout << "[bench] " << device->pipeline_cache->to_str() << "\n";
+    cout << "[bench] " << device->shaders->to_str() << "\n";
+    cout << "[bench] " << pipelines->to_str() << "\n";
+    cout << "[bench] " << device->deletion_queue->to_str() << "\n";
+    if (static_scene) {
+      cout << "[bench] " << command_cache->to_str() << "\n";
+    }
+
+    return num_frames / secs;
+  }
+
+  // --bench once per num of frames in flight, to pick the throughput / latency tradeoff
+  void frames_inflight_bench(u32 num_frames) {
+    u32 initial = frames_inflight;
+
+    vector<string> summary;
+    for (u32 n = 1; n <= max_frames_inflight; ++n) {
+      set_frames_inflight(n);
+      gpu_timings->clear();
+
+      double fps = bench(num_frames);
+      summary.push_back(format(
+        "[frames-inflight-bench] {} in flight: {:8.1f} frames/sec, latency p50 {:.3f} ms, p99 {:.3f} ms\n",
+        n,
+        fps,
+        latency.p50(),
+        latency.p99()
+      ));
+    }
+
+    for (auto& line : summary) {
+      cout << line;
+    }
+
+    set_frames_inflight(initial);
+  }
+
+  // --bench once per present policy (and w/ / w/o present wait pacing if there's present wait),
+  // to compare the frame time variance and latency of each
+  void present_bench(u32 num_frames) {
+    if (headless) {
+      throw runtime_error("--present-bench needs a window, headless frames aren't presented");
+    }
+
+    PresentPolicy initial_policy = present_policy;
+    bool initial_pacing = pace_presents;
+
+    vector<string> summary;
+    for (auto policy : { PresentPolicy::low_latency, PresentPolicy::vsync, PresentPolicy::uncapped }) {
+      for (bool pacing : { false, true }) {
+        if (pacing && !device->present_wait) {
+          continue;
+        }
+
+        set_present_policy(policy);
+        pace_presents = pacing;
+        gpu_timings->clear();
+
+        double fps = bench(num_frames);
+        summary.push_back(format(
+          "[present-bench] {:11}{:9}: {:8.1f} frames/sec, frame time stddev {:.3f} ms, p99 {:.3f} ms, "
+          "latency p50 {:.3f} ms, p99 {:.3f} ms\n",
+          to_str(policy),
+          pacing ? " + paced" : "",
+          fps,
+          frame_time.stddev(),
+          frame_time.p99(),
+          latency.p50(),
+          latency.p99()
+        ));
+      }
+    }
+
+    for (auto& line : summary) {
+      cout << line;
+    }
+
+    pace_presents = initial_pacing;
+    set_present_policy(initial_policy);
+  }
+
+  // --bench num_instances copies drawn w/ one draw call each vs all of them in one instanced draw
+  void instance_bench(u32 num_frames, u32 num_instances = 10000) {
+    u32 initial_draws = draw_calls;
+    u32 initial_instances = instances ? instances->size() : 0;
+
+    set_instances(num_instances);
+
+    vector<string> summary;
+    for (u32 draws : { num_instances, 1u }) {
+      draw_calls = draws;
+      gpu_timings->clear();
+
+      double fps = bench(num_frames);
+      summary.push_back(format(
+        "[instance-bench] {} instances in {:5} draws: {:8.1f} frames/sec, record {:.3f} ms, frame time p99 {:.3f} ms\n",
+        num_instances,
+        draws,
+        fps,
+        record_time.mean(),
+        frame_time.p99()
+      ));
+    }
+
+    for (auto& line : summary) {
+      cout << line;
+    }
+
+    draw_calls = initial_draws;
+    set_instances(initial_instances);
+  }
+
+  // --bench the same instances drawn w/ one CPU draw call each vs culled & drawn by the GPU, for a
+  // few num of instances. The CPU side of the GPU-driven path shouldn't grow w/ the num of them
+  void gpu_driven_bench(u32 num_frames) {
+    u32 initial_draws = draw_calls;
+    u32 initial_instances = instances ? instances->size() : 0;
+    bool initial_gpu_driven = culling != nullptr;
+
+    vector<string> summary;
+    for (u32 n : { 1000u, 10000u, 100000u }) {
+      set_instances(n);
+
+      for (bool gpu_driven : { false, true }) {
+        set_gpu_driven(gpu_driven);
+        draw_calls = gpu_driven ? 1 : n;
+        gpu_timings->clear();
+
+        double fps = bench(num_frames);
+        summary.push_back(format(
+          "[gpu-driven-bench] {:6} instances, {}: record {:8.3f} ms, {:8.1f} frames/sec\n",
+          n,
+          gpu_driven ? "culled & drawn indirectly" : "one draw call each       ",
+          record_time.mean(),
+          fps
+        ));
+      }
+    }
+
+    for (auto& line : summary) {
+      cout << line;
+    }
+
+    draw_calls = initial_draws;
+    set_instances(initial_instances);
+    set_gpu_driven(initial_gpu_driven);
+  }
+
+  // --bench the triangle swapped for a grid of ~num_vertices vertices, rotated every frame by the
+  // CPU into the ring buffer vs by a compute pass. The GPU cost of the latter is what the command
+  // buffer spends before the render pass
+  void animation_bench(u32 num_frames, u32 num_vertices = 1000000) {
+    auto initial_triangle = triangle;
+    VkDeviceSize initial_ring_size = ring_size;
+    bool initial_stream = stream;
+    bool initial_gpu_animation = animator != nullptr;
+
+    triangle = grid_triangles(static_cast<u32>(sqrt(num_vertices / 6.0)));
+
+    // the old ring is destroyed once the frames in flight are done w/ it, see DeletionQueue
+    ring_size = sizeof(SceneVertex) * triangle.size();
+    ring = mk_ptr<RingBuffer>(device, ring_size, frames_inflight);
+
+    vector<string> summary;
+    for (bool gpu : { false, true }) {
+      stream = !gpu;
+      set_gpu_animation(gpu);
+      gpu_timings->clear();
+
+      double fps = bench(num_frames);
+      summary.push_back(format(
+        "[animation-bench] {} vertices, {}: cpu {:8.3f} ms, gpu {:8.3f} ms, {:8.1f} frames/sec\n",
+        triangle.size(),
+        gpu ? "compute shader" : "CPU into ring ",
+        gpu ? 0.0 : animate_time.mean(),
+        gpu ? gpu_timings->cmd.mean() - gpu_timings->pass.mean() : 0.0,
+        fps
+      ));
+    }
+
+    for (auto& line : summary) {
+      cout << line;
+    }
+
+    triangle = initial_triangle;
+    ring_size = initial_ring_size;
+    ring = mk_ptr<RingBuffer>(device, ring_size, frames_inflight);
+    stream = initial_stream;
+    set_gpu_animation(initial_gpu_animation);
+  }
+
+  // --bench for a few num of draw calls x num of recording threads, to see where recording in
+  // parallel starts to pay off. 0 threads is recorded inline, w/o secondary buffers
+  void record_bench(u32 num_frames) {
+    u32 initial_draws = draw_calls;
+    u32 initial_threads = record_workers ? record_workers->size() : 0;
+    u32 max_threads = (std::max)(thread::hardware_concurrency(), 1u);
+
+    vector<string> summary;
+    for (u32 draws : { 1000u, 10000u, 50000u }) {
+      for (u32 threads : { 0u, 1u, 2u, 4u, 8u }) {
+        if (threads > max_threads) {
+          continue;
+        }
+
+        draw_calls = draws;
+        set_record_threads(threads);
+        gpu_timings->clear();
+
+        double fps = bench(num_frames);
+        summary.push_back(format(
+          "[record-bench] {:6} draws, {} threads: record {:8.3f} ms (p99 {:8.3f} ms), {:8.1f} frames/sec\n",
+          draws,
+          threads,
+          record_time.mean(),
+          record_time.p99(),
+          fps
+        ));
+      }
+    }
+
+    for (auto& line : summary) {
+      cout << line;
+    }
+
+    draw_calls = initial_draws;
+    set_record_threads(initial_threads);
   }
 };
 
 
-int main() {
+int main(int argc, char** argv) {
   try {
-    auto triangle = mk_ptr<BetterTriangle>(800, 600);
-    triangle->run();
+    // --headless    render into offscreen images, no window / surface / swapchain. implies --bench
+    // --bench N     draw N frames as fast as possible, report frames/sec and exit
+    // --stream      re-upload the vertices every frame through the per-frame ring buffer
+    // --mesh-bench  report vertices shaded w/ and w/o indexing / cache reordering, no GPU needed
+    // --format-bench  --bench a big grid mesh once per vertex format
+    // --pipeline-cache-bench  time pipeline creation w/ and w/o the pipeline cache
+    // --pipeline-compile-bench K  compile K (<= 48) pipeline variants serially vs on the worker threads
+    // --lights N / --grayscale  specialize shader.frag
+    // --frames-inflight N  1 - 4, default 2
+    // --frames-inflight-bench  --bench w/ every num of frames in flight
+    // --static      replay pre-recorded command buffers, only re-recorded when something changed
+    // --alloc-audit N  draw N frames after a warmup, fail if any of them heap allocates on the main
+    //               thread. Needs a build w/ ALLOC_AUDIT defined, i.e. Debug
+    // --draws N     draw the scene N times, one draw call each
+    // --record-threads N  record the draws on N worker threads into secondary command buffers
+    // --record-bench  --bench w/ a few num of draws x recording threads
+    // --present P   present policy: low-latency (default), vsync or uncapped
+    // --fps-limit N  cap the frame rate on the CPU
+    // --present-wait  start a frame only once the last one is displayed, if there's VK_KHR_present_wait
+    // --present-bench  --bench w/ every present policy, w/ and w/o present wait
+    // --instances N  draw N copies of the scene w/ one instanced draw (split by --draws)
+    // --instance-bench  --bench 10k copies drawn one draw call each vs one instanced draw
+    // --gpu-driven  cull the instances in a compute pass and draw them indirectly
+    // --gpu-driven-bench  --bench CPU draw calls vs GPU-driven for 1k / 10k / 100k instances
+    // --gpu-animation  like --stream, but the vertices are rotated by a compute shader
+    // --animation-bench  --bench 1M vertices rotated by the CPU (--stream) vs --gpu-animation
+    bool headless = false;
+    bool stream = false;
+    bool static_scene = false;
+    bool format_bench = false;
+    bool pipeline_cache_bench = false;
+    u32 pipeline_compile_variants = 0;
+    SpecConstants frag_constants;
+    u32 frames_inflight = 2;
+    bool frames_inflight_bench = false;
+    u32 alloc_audit_frames = 0;
+    u32 draw_calls = 1;
+    u32 record_threads = 0;
+    bool record_bench = false;
+    PresentPolicy present_policy = PresentPolicy::low_latency;
+    double fps_limit = 0.0;
+    bool present_wait = false;
+    bool present_bench = false;
+    u32 num_instances = 0;
+    bool instance_bench = false;
+    bool gpu_driven = false;
+    bool gpu_driven_bench = false;
+    bool gpu_animation = false;
+    bool animation_bench = false;
+    u32 bench_frames = 0;
+
+    for (int i = 1; i < argc; ++i) {
+      string arg = argv[i];
+      if (arg == "--headless") {
+        headless = true;
+      } else if (arg == "--mesh-bench") {
+        mesh_bench();
+        return EXIT_SUCCESS;
+      } else if (arg == "--pipeline-cache-bench") {
+        pipeline_cache_bench = true;
+      } else if (arg == "--pipeline-compile-bench" && i + 1 < argc) {
+        pipeline_compile_variants = static_cast<u32>(stoul(argv[++i]));
+      } else if (arg == "--lights" && i + 1 < argc) {
+        frag_constants.set(SPEC_LIGHT_COUNT, stoi(argv[++i]));
+      } else if (arg == "--grayscale") {
+        frag_constants.set(SPEC_GRAYSCALE, true);
+      } else if (arg == "--frames-inflight" && i + 1 < argc) {
+        frames_inflight = static_cast<u32>(stoul(argv[++i]));
+      } else if (arg == "--alloc-audit" && i + 1 < argc) {
+        alloc_audit_frames = static_cast<u32>(stoul(argv[++i]));
+      } else if (arg == "--frames-inflight-bench") {
+        frames_inflight_bench = true;
+      } else if (arg == "--format-bench") {
+        format_bench = true;
+      } else if (arg == "--draws" && i + 1 < argc) {
+        draw_calls = static_cast<u32>(stoul(argv[++i]));
+        if (draw_calls == 0) {
+          throw runtime_error("--draws must be at least 1");
+        }
+      } else if (arg == "--record-threads" && i + 1 < argc) {
+        record_threads = static_cast<u32>(stoul(argv[++i]));
+      } else if (arg == "--record-bench") {
+        record_bench = true;
+      } else if (arg == "--present" && i + 1 < argc) {
+        present_policy = ::present_policy(argv[++i]);
+      } else if (arg == "--fps-limit" && i + 1 < argc) {
+        fps_limit = stod(argv[++i]);
+      } else if (arg == "--present-wait") {
+        present_wait = true;
+      } else if (arg == "--present-bench") {
+        present_bench = true;
+      } else if (arg == "--instances" && i + 1 < argc) {
+        num_instances = static_cast<u32>(stoul(argv[++i]));
+      } else if (arg == "--instance-bench") {
+        instance_bench = true;
+      } else if (arg == "--gpu-driven") {
+        gpu_driven = true;
+      } else if (arg == "--gpu-driven-bench") {
+        gpu_driven_bench = true;
+      } else if (arg == "--gpu-animation") {
+        gpu_animation = true;
+      } else if (arg == "--animation-bench") {
+        animation_bench = true;
+      } else if (arg == "--static") {
+        static_scene = true;
+      } else if (arg == "--stream") {
+        stream = true;
+      } else if (arg == "--bench" && i + 1 < argc) {
+        bench_frames = static_cast<u32>(stoul(argv[++i]));
+      } else {
+        throw runtime_error(format("unknown argument {}", arg));
+      }
+    }
+
+    if ((headless || format_bench || frames_inflight_bench || record_bench || present_bench || instance_bench ||
+         gpu_driven_bench || animation_bench) &&
+        bench_frames == 0
+    ) {
+      bench_frames = 1000;
+    }
+
+    auto triangle = mk_ptr<BetterTriangle>(800, 600, headless, frames_inflight);
+    triangle->stream = stream;
+    triangle->static_scene = static_scene;
+    triangle->draw_calls = draw_calls;
+    if (record_threads > 0) {
+      triangle->set_record_threads(record_threads);
+    }
+    if (present_policy != PresentPolicy::low_latency) {
+      triangle->set_present_policy(present_policy);
+    }
+    triangle->set_fps_limit(fps_limit);
+    triangle->pace_presents = present_wait;
+    if (num_instances > 0) {
+      triangle->set_instances(num_instances);
+    }
+    if (gpu_driven) {
+      triangle->set_gpu_driven(true);
+    }
+    if (gpu_animation) {
+      triangle->set_gpu_animation(true);
+    }
+    if (!frag_constants.empty()) {
+      triangle->specialize(frag_constants);
+    }
+    if (alloc_audit_frames > 0) {
+      if (!triangle->alloc_audit(alloc_audit_frames)) {
+        return EXIT_FAILURE;
+      }
+    } else if (pipeline_cache_bench) {
+      triangle->pipeline_cache_bench();
+    } else if (pipeline_compile_variants > 0) {
+      triangle->pipeline_compile_bench(pipeline_compile_variants);
+    } else if (frames_inflight_bench) {
+      triangle->frames_inflight_bench(bench_frames);
+    } else if (animation_bench) {
+      triangle->animation_bench(bench_frames);
+    } else if (gpu_driven_bench) {
+      triangle->gpu_driven_bench(bench_frames);
+    } else if (instance_bench) {
+      triangle->instance_bench(bench_frames);
+    } else if (present_bench) {
+      triangle->present_bench(bench_frames);
+    } else if (record_bench) {
+      triangle->record_bench(bench_frames);
+    } else if (format_bench) {
+      triangle->format_bench(bench_frames);
+    } else if (bench_frames > 0) {
+      triangle->bench(bench_frames);
+    } else {
+      triangle->run();
+    }
   } catch (const exception& ex) {
     cerr << ex.what() << endl;
     return EXIT_FAILURE;
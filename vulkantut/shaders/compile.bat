@@ -1,3 +1,6 @@
 C:\VulkanSDK\1.3.211.0\Bin\glslc.exe shader.vert -o vert.spv
 C:\VulkanSDK\1.3.211.0\Bin\glslc.exe shader.frag -o frag.spv
+C:\VulkanSDK\1.3.211.0\Bin\glslc.exe instanced.vert -o instanced_vert.spv
+C:\VulkanSDK\1.3.211.0\Bin\glslc.exe cull.comp -o cull_comp.spv
+C:\VulkanSDK\1.3.211.0\Bin\glslc.exe animate.comp -o animate_comp.spv
 pause
@@ -0,0 +1,15 @@
+#version 450
+
+layout(location = 0) in vec2 inPosition;
+layout(location = 1) in vec3 inColor;
+
+// per instance, see Instance in Vertex.h
+layout(location = 3) in vec3 inOffsetScale;
+layout(location = 4) in vec3 inTint;
+
+layout(location = 0) out vec3 fragColor;
+
+void main() {
+    gl_Position = vec4(inPosition * inOffsetScale.z + inOffsetScale.xy, 0.0, 1.0);
+    fragColor = inColor * inTint;
+}
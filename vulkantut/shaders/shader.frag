@@ -1,9 +1,25 @@
 #version 450
 
+// specialization constants, baked in per pipeline (see SpecConstants / SpecId in Shader.h).
+// The values here are the defaults, used when a pipeline doesn't specialize them
+layout(constant_id = 0) const int LIGHT_COUNT = 0;
+layout(constant_id = 1) const bool GRAYSCALE = false;
+
 layout(location = 0) in vec3 fragColor;
 
 layout(location = 0) out vec4 outColor;
 
 void main() {
-    outColor = vec4(fragColor, 1.0);
+    vec3 color = fragColor;
+
+    // stand-in for per light shading, the loop is unrolled / dropped entirely by the driver
+    for (int i = 0; i < LIGHT_COUNT; ++i) {
+        color *= 1.1;
+    }
+
+    if (GRAYSCALE) {
+        color = vec3(dot(color, vec3(0.299, 0.587, 0.114)));
+    }
+
+    outColor = vec4(color, 1.0);
 }
@@ -20,6 +20,8 @@
 #include <algorithm>
 #include <sstream>
 #include <memory>
+#include <chrono>
+#include <cmath>
 
 namespace utils {
   using namespace std;
@@ -147,6 +149,73 @@ namespace utils {
     return to_str(s, "{", ",", "}");
   }
 
+  // fixed size window over the last `capacity` samples, old samples are overwritten.
+  // add() never allocates, so it's fine to call it from the frame loop
+  class RollingStats {
+    vector<double> samples;
+    size_t next = 0;
+    size_t count = 0;
+
+  public:
+    RollingStats(size_t capacity = 512) : samples(capacity) {}
+
+    void add(double sample) {
+      samples[next] = sample;
+      next = (next + 1) % samples.size();
+      count = std::min(count + 1, samples.size());
+    }
+
+    size_t size() const { return count; }
+
+    void clear() {
+      next = 0;
+      count = 0;
+    }
+
+    double mean() const {
+      if (count == 0) {
+        return 0.0;
+      }
+
+      double sum = 0.0;
+      for (size_t i = 0; i < count; ++i) {
+        sum += samples[i];
+      }
+      return sum / count;
+    }
+
+    // population variance, e.g. of frame times: how uneven the pacing is, whatever the mean
+    double variance() const {
+      if (count == 0) {
+        return 0.0;
+      }
+
+      double m = mean();
+      double sum = 0.0;
+      for (size_t i = 0; i < count; ++i) {
+        sum += (samples[i] - m) * (samples[i] - m);
+      }
+      return sum / count;
+    }
+
+    double stddev() const { return std::sqrt(variance()); }
+
+    // p in [0, 1], nearest-rank
+    double percentile(double p) const {
+      if (count == 0) {
+        return 0.0;
+      }
+
+      vector<double> sorted(samples.cbegin(), samples.cbegin() + count);
+      auto nth = sorted.begin() + static_cast<size_t>(p * (count - 1) + 0.5);
+      nth_element(sorted.begin(), nth, sorted.end());
+      return *nth;
+    }
+
+    double p50() const { return percentile(0.5); }
+    double p99() const { return percentile(0.99); }
+  };
+
   vector<char> read_file(const string& fname) {
     ifstream file(fname, ios::ate | ios::binary);
 
@@ -50,3 +50,29 @@ VkDeviceQueueCreateInfo vk_queue_create_info(u32 family_index, const float* prio
   return res;
 }
 
+// one half of a queue family ownership transfer of [offset, offset + size) of buffer: the release,
+// recorded on a queue of src_family (dst_access is ignored there), or the acquire, recorded on one
+// of dst_family (src_access ignored). Both halves must name the same families and range, and the
+// acquire must run after the release (a semaphore between the submissions). Not needed between
+// queues of the same family
+VkBufferMemoryBarrier vk_ownership_barrier(
+  VkBuffer buffer,
+  VkDeviceSize offset,
+  VkDeviceSize size,
+  u32 src_family,
+  u32 dst_family,
+  VkAccessFlags src_access,
+  VkAccessFlags dst_access
+) {
+  VkBufferMemoryBarrier res{};
+  res.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+  res.srcAccessMask = src_access;
+  res.dstAccessMask = dst_access;
+  res.srcQueueFamilyIndex = src_family;
+  res.dstQueueFamilyIndex = dst_family;
+  res.buffer = buffer;
+  res.offset = offset;
+  res.size = size;
+  return res;
+}
+